@@ -0,0 +1,120 @@
+// ackCheck.c
+// an order must not be acknowledged before its journal record is on disk. the server runs
+// with a preloaded fdatasync that sleeps SYNC_DELAY_MS first, so a reply that comes back
+// sooner was sent before the sync finished. checked on the epoll front ends and on the
+// thread per connection model. built a second time with -DSYNC_DELAY_SHIM as the preload
+#define _GNU_SOURCE // RTLD_NEXT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SYNC_DELAY_MS 300
+
+#ifdef SYNC_DELAY_SHIM
+#include <dlfcn.h>
+
+int fdatasync(int fd) {
+    static int (*realSync)(int) = NULL;
+    if (realSync == NULL) realSync = (int (*)(int))dlsym(RTLD_NEXT, "fdatasync");
+    struct timespec delay = { SYNC_DELAY_MS / 1000, (SYNC_DELAY_MS % 1000) * 1000000L };
+    nanosleep(&delay, NULL);
+    return realSync(fd);
+}
+
+#else
+#include <signal.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define CHECK_IP "127.0.0.1"
+#define CHECK_JOURNAL "ackCheck.journal"
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+pid_t startServer(int port, const char *frontEnds) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        exit(1);
+    }
+    if (pid == 0) {
+        char portText[16];
+        snprintf(portText, sizeof(portText), "%d", port);
+        int quiet = open("/dev/null", O_WRONLY);
+        dup2(quiet, STDOUT_FILENO);
+        setenv("LD_PRELOAD", "./syncDelay.so", 1);
+        setenv("PIDESHOP_JOURNAL", CHECK_JOURNAL, 1);
+        setenv("PIDESHOP_ADMIN_PORT", "0", 1);
+        execl("./serverExe", "serverExe", CHECK_IP, portText, "1", "1", "100", frontEnds, (char *)NULL);
+        perror("Failed to start ./serverExe");
+        exit(1);
+    }
+    return pid;
+}
+
+// the server replays and syncs its journal before it listens, retries until it does
+int connectServer(int port) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, CHECK_IP, &address.sin_addr);
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) return fd;
+        close(fd);
+        usleep(50000);
+    }
+    return -1;
+}
+
+// returns 0 when the reply waited for the sync
+int checkAck(int port, const char *frontEnds) {
+    remove(CHECK_JOURNAL);
+    pid_t server = startServer(port, frontEnds);
+    int fd = connectServer(port);
+    if (fd == -1) {
+        printf("front ends %s: server did not come up\n", frontEnds);
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        return 1;
+    }
+    const char *order = "O 1 3 4 1\n";
+    char reply[128];
+    long start = nowNs();
+    int got = 0;
+    if (write(fd, order, strlen(order)) == (ssize_t)strlen(order)) {
+        ssize_t n;
+        while (got < (int)sizeof(reply) - 1 && (n = read(fd, reply + got, sizeof(reply) - 1 - got)) > 0) {
+            got += n;
+            if (memchr(reply, '\n', got) != NULL) break;
+        }
+    }
+    long elapsedMs = (nowNs() - start) / 1000000;
+    reply[got] = '\0';
+    close(fd);
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    remove(CHECK_JOURNAL);
+
+    int failed = strncmp(reply, "R 1 ", 4) != 0 || elapsedMs < SYNC_DELAY_MS * 9 / 10;
+    printf("front ends %s: ack after %ld ms, a sync takes %d ms: %s\n", frontEnds, elapsedMs, SYNC_DELAY_MS,
+           failed ? "FAILED" : "ok");
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    int port = (argc >= 2) ? atoi(argv[1]) : 8191;
+    int failed = checkAck(port, "2"); // epoll front ends
+    failed |= checkAck(port + 10, "0"); // thread per connection
+    return failed;
+}
+#endif
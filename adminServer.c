@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "adminServer.h"
+
+#define ADMIN_REQUEST_BYTES 4096
+
+typedef struct {
+    int listenSocket;
+    MetricsWriter writer;
+    AdminTick tick;
+    void *ctx;
+    pthread_t thread;
+} AdminServer;
+
+AdminServer admin;
+
+long adminClockNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+__attribute__((format(printf, 2, 3)))
+void appendText(MetricsText *out, const char *format, ...) {
+    while (1) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(out->text + out->length, out->capacity - out->length, format, args);
+        va_end(args);
+        if (length < 0) return;
+        if (out->length + length < out->capacity) {
+            out->length += length;
+            return;
+        }
+        size_t capacity = out->capacity ? out->capacity * 2 : 16384;
+        char *text = (char *)realloc(out->text, capacity);
+        if (text == NULL) return; // the scrape comes back short
+        out->text = text;
+        out->capacity = capacity;
+    }
+}
+
+void metricHeader(MetricsText *out, const char *name, const char *type, const char *help) {
+    appendText(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metricValue(MetricsText *out, const char *name, const char *labels, double value) {
+    if (labels != NULL) appendText(out, "%s{%s} %.9g\n", name, labels, value);
+    else appendText(out, "%s %.9g\n", name, value);
+}
+
+void sampleRate(RateWindow *window, long count, long nowNs) {
+    window->counts[window->next] = count;
+    window->timesNs[window->next] = nowNs;
+    window->next = (window->next + 1) % RATE_WINDOW_SAMPLES;
+    if (window->filled < RATE_WINDOW_SAMPLES) window->filled++;
+}
+
+double windowRate(const RateWindow *window) {
+    if (window->filled < 2) return 0.0;
+    int newest = (window->next + RATE_WINDOW_SAMPLES - 1) % RATE_WINDOW_SAMPLES;
+    int oldest = (window->filled < RATE_WINDOW_SAMPLES) ? 0 : window->next;
+    long elapsed = window->timesNs[newest] - window->timesNs[oldest];
+    return elapsed > 0 ? (window->counts[newest] - window->counts[oldest]) * 1e9 / elapsed : 0.0;
+}
+
+// one request per connection, anything but GET /metrics or GET / is a 404
+void serveScrape(int client, MetricsText *body) {
+    char request[ADMIN_REQUEST_BYTES];
+    struct timeval timeout = { 1, 0 }; // a stuck scraper only delays the next scrape
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    ssize_t length = recv(client, request, sizeof(request) - 1, 0);
+    if (length <= 0) return;
+    request[length] = '\0';
+
+    char header[160];
+    int found = strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0;
+    body->length = 0;
+    if (found) admin.writer(body, admin.ctx);
+    else appendText(body, "not found\n");
+    int headerLength = snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                found ? "200 OK" : "404 Not Found", body->length);
+    if (send(client, header, headerLength, MSG_NOSIGNAL) != headerLength) return;
+    for (size_t sent = 0; sent < body->length; ) {
+        ssize_t written = send(client, body->text + sent, body->length - sent, MSG_NOSIGNAL);
+        if (written <= 0) return;
+        sent += written;
+    }
+}
+
+void *adminThread(void *arg) {
+    MetricsText body = { NULL, 0, 0 };
+    long nextTick = adminClockNs();
+    while (1) {
+        long now = adminClockNs();
+        if (now >= nextTick) {
+            admin.tick(admin.ctx);
+            nextTick = now + ADMIN_TICK_MS * 1000000L;
+        }
+        struct pollfd listening = { admin.listenSocket, POLLIN, 0 };
+        int ready = poll(&listening, 1, (int)((nextTick - now) / 1000000L) + 1);
+        if (ready == -1 && errno != EINTR) {
+            perror("admin poll failed");
+            break;
+        }
+        if (ready <= 0) continue;
+        int client = accept(admin.listenSocket, NULL, NULL);
+        if (client == -1) continue;
+        serveScrape(client, &body);
+        close(client);
+    }
+    free(body.text);
+    return NULL;
+}
+
+int startAdminServer(int listenSocket, MetricsWriter writer, AdminTick tick, void *ctx) {
+    admin.listenSocket = listenSocket;
+    admin.writer = writer;
+    admin.tick = tick;
+    admin.ctx = ctx;
+    if (pthread_create(&admin.thread, NULL, adminThread, NULL) != 0) return -1;
+    pthread_detach(admin.thread);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ADMIN_SERVER_H
+#define ADMIN_SERVER_H
+
+#include <stddef.h>
+
+#define ADMIN_TICK_MS 1000 // how often the admin thread calls tick, rate windows sample on it
+#define RATE_WINDOW_SAMPLES 10 // rates are averaged over this many ticks
+
+// Prometheus text exposition, grown as metrics are appended
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+} MetricsText;
+
+// per second change of a counter over the last RATE_WINDOW_SAMPLES ticks
+typedef struct {
+    long counts[RATE_WINDOW_SAMPLES];
+    long timesNs[RATE_WINDOW_SAMPLES];
+    int next;
+    int filled;
+} RateWindow;
+
+typedef void (*MetricsWriter)(MetricsText *out, void *ctx);
+typedef void (*AdminTick)(void *ctx);
+
+void metricHeader(MetricsText *out, const char *name, const char *type, const char *help);
+void metricValue(MetricsText *out, const char *name, const char *labels, double value); // labels like "cook=\"1\"" or NULL
+void sampleRate(RateWindow *window, long count, long nowNs);
+double windowRate(const RateWindow *window);
+
+// serves GET /metrics on listenSocket from one thread. the writer must only read the shop,
+// a scrape never takes a lock the cooks or couriers wait on
+int startAdminServer(int listenSocket, MetricsWriter writer, AdminTick tick, void *ctx); // -1 if the thread cannot start
+
+#endif
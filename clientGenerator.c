@@ -1,109 +1,514 @@
 // hungry_very_much.c
+// open loop load generator. every worker thread keeps one framed connection (one server
+// session) and sends its orders at scheduled arrival times whether or not the shop keeps up.
+// latency is measured from the scheduled time, not from when the send happened, so a stalled
+// server shows up in the numbers instead of slowing the generator down (coordinated omission).
+// delivery is found by polling "S" for every acked order. only an explicit Delivered counts,
+// an order the shop cancelled or no longer knows is reported as lost
+#define _GNU_SOURCE // ppoll
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <math.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <time.h>
+#include "fastRandom.h"
+#include "latencyHistogram.h"
 
-#define BUFFER_SIZE 2048
+#define MESSAGE_SIZE 2048
+#define OUT_BUFFER_SIZE 65536
+#define PIPELINE_WINDOW 64 // closed loop only, messages sent before waiting for their replies
+#define ORDER_BATCH_SIZE 100 // closed loop only, orders carried by one "B" message
+#define MESSAGE_RING 65536 // messages in flight per worker, must be a power of two
+#define STATUS_INTERVAL_MS 20 // how often a worker sweeps its undelivered orders
+#define STATUS_PER_SWEEP 256 // status queries per sweep, the sweep continues where it stopped
+#define DRAIN_TIMEOUT_S 60 // give up on deliveries after this long without one
+#define MAX_HOTSPOTS 4
+
+#define ARRIVAL_POISSON 0
+#define ARRIVAL_CONSTANT 1
+
+#define SPREAD_UNIFORM 0 // every point of the p x q rectangle around the shop
+#define SPREAD_GAUSS 1 // normal around the shop, sigma p/3 and q/3
+#define SPREAD_HOTSPOT 2 // 80% close to a few random points, the rest uniform
+
+#define MESSAGE_ORDERS 0
+#define MESSAGE_STATUS 1
+#define MESSAGE_END 2
+
+// how an order left the worker's books
+#define OUTCOME_REJECTED 0 // never acked, counted as an error
+#define OUTCOME_DELIVERED 1
+#define OUTCOME_LOST 2 // acked, then cancelled or unknown to the shop
+
+typedef struct {
+    int kind;
+    int firstOrder; // orders: first order index, status: the order asked about
+    int count;
+} Message;
 
 typedef struct {
-    char *serverIp;
-    int serverPort;  
-    int x;
-    int y; 
-    int totalOrderAmount;
-    int clientId; 
-} Client;
- 
-void sendOrder(Client *client); 
-
-Client client;
-
-void handle_signal(int signum) { 
-    printf("signal .. cancelling orders .. editing log..\n"); 
+    int id;
+    int sock;
+    int orderCount; // this worker's share
+    double rate; // orders per second, 0 sends as fast as the pipeline window allows
+    long *intendedNs; // scheduled send time per order
+    int *orderIds; // 0 until acked
+    char *done; // delivered, lost or rejected
+    int sent;
+    long lastSentNs; // the send phase ends here, the rest is waiting for deliveries
+    int acked;
+    int finished;
+    int delivered;
+    int lost;
+    int errors;
+    int sweepCursor;
+    unsigned int nextSeq;
+    unsigned int ackedSeq;
+    Message messages[MESSAGE_RING];
+    int outLen;
+    char out[OUT_BUFFER_SIZE];
+    int replyLen;
+    char replies[MESSAGE_SIZE * 8];
+    LatencyHistogram ackLatency; // intended send -> reply with the order id
+    LatencyHistogram deliveredLatency; // intended send -> first status poll that found it delivered
+    pthread_t thread;
+} Worker;
+
+char *serverIp;
+int serverPort;
+int totalOrderAmount;
+int p, q;
+int arrival = ARRIVAL_POISSON;
+int spread = SPREAD_UNIFORM;
+int hotspots[MAX_HOTSPOTS][2];
+const char *arrivalNames[] = { "poisson", "constant" };
+const char *spreadNames[] = { "uniform", "gauss", "hotspot" };
+
+void connectToServer(Worker *worker);
+void *workerThread(void *arg);
+void writeResults(const char *path, Worker *workers, int threadCount, double targetRate, long startNs);
+
+void handle_signal(int signum) {
+    printf("signal .. cancelling orders .. editing log..\n");
     exit(0);
 }
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int parseName(const char *text, const char **names, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(text, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
 int main(int argc, char *argv[]) {
 
-    if (argc != 6) {
-        printf("Wrong Argument, please enter proper arguments: [ip] [portnumber] [numberOfClients] [p] [q]\n");
+    if (argc < 6 || argc > 11) {
+        printf("Wrong Argument, please enter proper arguments: [ip] [portnumber] [numberOfClients] [p] [q] [threads(optional)] [ordersPerSecond(optional, 0 = as fast as replies come)] [poisson|constant(optional)] [uniform|gauss|hotspot(optional)] [resultFile.csv|.json(optional)]\n");
         exit(1);
-    } 
-  
-    client.serverIp = argv[1]; 
-    client.serverPort = atoi(argv[2]);
-    client.totalOrderAmount = atoi(argv[3]);
-    int p = atoi(argv[4]);
-    int q = atoi(argv[5]);
-
-    srand(time(NULL));
-    
+    }
+
+    serverIp = argv[1];
+    serverPort = atoi(argv[2]);
+    totalOrderAmount = atoi(argv[3]);
+    p = atoi(argv[4]);
+    q = atoi(argv[5]);
+    int threadCount = (argc >= 7) ? atoi(argv[6]) : 1;
+    double targetRate = (argc >= 8) ? atof(argv[7]) : 0;
+    if (argc >= 9) arrival = parseName(argv[8], arrivalNames, 2);
+    if (argc >= 10) spread = parseName(argv[9], spreadNames, 3);
+    const char *resultFile = (argc >= 11) ? argv[10] : NULL;
+    if (totalOrderAmount <= 0 || p <= 0 || q <= 0 || threadCount <= 0 || threadCount > totalOrderAmount || targetRate < 0 || arrival == -1 || spread == -1) {
+        printf("orders, p, q and threads must be positive, threads at most the orders, arrival poisson or constant, spread uniform, gauss or hotspot\n");
+        exit(1);
+    }
+
+    const char *seed = getenv("PIDESHOP_SEED"); // same seed, same customer locations
+    setRandomSeed(seed != NULL ? strtoull(seed, NULL, 10) : (uint64_t)time(NULL));
+    for (int i = 0; i < MAX_HOTSPOTS; ++i) {
+        hotspots[i][0] = randomBelow(2 * p + 1) - p;
+        hotspots[i][1] = randomBelow(2 * q + 1) - q;
+    }
+
     signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal); 
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
 
     printf("PID %d..\n",getpid());
     printf("...\n");
-    for (int i = 0; i < client.totalOrderAmount; ++i) {
-        if(rand() % 2 == 0)
-            client.x = -1 * (rand() % p);
-        else client.x = (rand() % p);
-
-        if(rand() % 2 == 0)
-            client.y = -1 * (rand() % q);
-        else client.y = (rand() % q); 
-        
-        sendOrder(&client); 
-        sleep(0.1);
-    }
-
-    // send signal to server to stop
-    client.x = -999;
-    client.y = -999;
-    sendOrder(&client);
+    Worker *workers = (Worker *)calloc(threadCount, sizeof(Worker));
+    if (workers == NULL) {
+        perror("Failed to allocate workers");
+        exit(1);
+    }
+    long start = nowNs();
+    for (int i = 0; i < threadCount; ++i) {
+        Worker *worker = &workers[i];
+        worker->id = i;
+        worker->orderCount = totalOrderAmount / threadCount + (i < totalOrderAmount % threadCount);
+        worker->rate = targetRate / threadCount;
+        worker->intendedNs = (long *)calloc(worker->orderCount, sizeof(long));
+        worker->orderIds = (int *)calloc(worker->orderCount, sizeof(int));
+        worker->done = (char *)calloc(worker->orderCount, 1);
+        if (worker->intendedNs == NULL || worker->orderIds == NULL || worker->done == NULL) {
+            perror("Failed to allocate worker orders");
+            exit(1);
+        }
+        connectToServer(worker); // one connection per worker, orders are pipelined over it
+        if (pthread_create(&worker->thread, NULL, workerThread, worker) != 0) {
+            perror("Worker thread creation failed");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    printf("All customers served!\n");
+    writeResults(resultFile, workers, threadCount, targetRate, start);
     printf("log file written ..\n");
-    
+
     return 0;
-} 
+}
 
-void sendOrder(Client *client) { 
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock == -1) {
+void connectToServer(Worker *worker) {
+    worker->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (worker->sock == -1) {
         perror("Socket creation failed");
         exit(1);
     }
 
     struct sockaddr_in server;
     server.sin_family = AF_INET; // AF_UNIX or af_local for local communication
-    server.sin_port = htons(client->serverPort);
+    server.sin_port = htons(serverPort);
 
-    if (inet_pton(AF_INET, client->serverIp, &server.sin_addr) <= 0) { // it is used when we wanna connect different computer with different ip address
+    if (inet_pton(AF_INET, serverIp, &server.sin_addr) <= 0) { // it is used when we wanna connect different computer with different ip address
         perror("Invalid server IP");
-        close(sock);
+        close(worker->sock);
         exit(1);
     }
 
-    if (connect(sock, (struct sockaddr *)&server, sizeof(server)) == -1) {
+    if (connect(worker->sock, (struct sockaddr *)&server, sizeof(server)) == -1) {
         perror("Connection to server failed");
-        close(sock);
+        close(worker->sock);
         exit(1);
     }
+    fcntl(worker->sock, F_SETFL, fcntl(worker->sock, F_GETFL) | O_NONBLOCK); // a full socket never stops the reads
+}
 
-    char message[BUFFER_SIZE];
-    snprintf(message, sizeof(message), "%d-%d-%d", client->x, client->y, client->totalOrderAmount); 
-    send(sock, message, strlen(message), 0);
+double uniformUnit() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0); // [0, 1)
+}
 
-    char response[BUFFER_SIZE];
-    int bytes_received = recv(sock, response, sizeof(response) - 1, 0);
-    if (bytes_received > 0) {
-        response[bytes_received] = '\0';
-        printf("%s\n", response);
-    } else {
-        printf("Failed to receive response from server.\n");
+int clampCoordinate(double value, int bound) {
+    int rounded = (int)lround(value);
+    return rounded < -bound ? -bound : (rounded > bound ? bound : rounded);
+}
+
+void pickLocation(int *x, int *y) {
+    if (spread == SPREAD_GAUSS) { // Box-Muller
+        double radius = sqrt(-2.0 * log(1.0 - uniformUnit())), angle = 2 * M_PI * uniformUnit();
+        *x = clampCoordinate(radius * cos(angle) * p / 3.0, p);
+        *y = clampCoordinate(radius * sin(angle) * q / 3.0, q);
+        return;
+    }
+    if (spread == SPREAD_HOTSPOT && randomBelow(10) < 8) {
+        int *hotspot = hotspots[randomBelow(MAX_HOTSPOTS)];
+        int dx = p / 8 + 1, dy = q / 8 + 1;
+        *x = clampCoordinate(hotspot[0] + randomBelow(2 * dx + 1) - dx, p);
+        *y = clampCoordinate(hotspot[1] + randomBelow(2 * dy + 1) - dy, q);
+        return;
+    }
+    if(randomBelow(2) == 0)
+        *x = -1 * randomBelow(p);
+    else *x = randomBelow(p);
+
+    if(randomBelow(2) == 0)
+        *y = -1 * randomBelow(q);
+    else *y = randomBelow(q);
+}
+
+// gap to the next arrival of this worker
+long nextGapNs(Worker *worker) {
+    if (arrival == ARRIVAL_CONSTANT) return (long)(1e9 / worker->rate);
+    return (long)(-log(1.0 - uniformUnit()) / worker->rate * 1e9);
+}
+
+// appends one message, the caller checks room with canSend first
+void queueMessage(Worker *worker, int kind, int firstOrder, int count, const char *text, int len) {
+    Message *message = &worker->messages[worker->nextSeq & (MESSAGE_RING - 1)];
+    message->kind = kind;
+    message->firstOrder = firstOrder;
+    message->count = count;
+    memcpy(worker->out + worker->outLen, text, len);
+    worker->outLen += len;
+    worker->nextSeq++;
+}
+
+int canSend(Worker *worker, int len) {
+    return worker->outLen + len <= OUT_BUFFER_SIZE && worker->nextSeq - worker->ackedSeq < MESSAGE_RING;
+}
+
+void sendOrders(Worker *worker, int firstOrder, int count, const int *locations) {
+    char message[MESSAGE_SIZE * 2];
+    int len;
+    if (count == 1) { // framed order "O <seq> <x> <y> <total>\n"
+        len = snprintf(message, sizeof(message), "O %u %d %d %d\n", worker->nextSeq, locations[0], locations[1], worker->orderCount);
+    } else { // "B <seq> <total> <count> <x1> <y1> ...\n", the reply lists one order id per location
+        len = snprintf(message, sizeof(message), "B %u %d %d", worker->nextSeq, worker->orderCount, count);
+        for (int i = 0; i < count; ++i) {
+            len += snprintf(message + len, sizeof(message) - len, " %d %d", locations[2 * i], locations[2 * i + 1]);
+        }
+        len += snprintf(message + len, sizeof(message) - len, "\n");
+    }
+    queueMessage(worker, MESSAGE_ORDERS, firstOrder, count, message, len);
+}
+
+void finishOrder(Worker *worker, int order, int outcome) {
+    if (worker->done[order]) return;
+    worker->done[order] = 1;
+    worker->finished++;
+    if (outcome == OUTCOME_LOST) worker->lost++;
+    if (outcome != OUTCOME_DELIVERED) return;
+    worker->delivered++;
+    long latency = (nowNs() - worker->intendedNs[order]) / 1000;
+    recordLatency(&worker->deliveredLatency, latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency);
+}
+
+// one status query per undelivered acked order, starting where the last sweep stopped
+void sweepStatus(Worker *worker) {
+    char message[64];
+    int queued = 0;
+    for (int looked = 0; looked < worker->orderCount && queued < STATUS_PER_SWEEP; ++looked) {
+        int order = worker->sweepCursor;
+        worker->sweepCursor = (worker->sweepCursor + 1) % worker->orderCount;
+        if (worker->done[order] || worker->orderIds[order] == 0) continue;
+        int len = snprintf(message, sizeof(message), "S %u %d\n", worker->nextSeq, worker->orderIds[order]);
+        if (!canSend(worker, len)) break;
+        queueMessage(worker, MESSAGE_STATUS, order, 0, message, len);
+        queued++;
+    }
+}
+
+void handleReply(Worker *worker, char *line) {
+    char tag, status[32];
+    unsigned int seq;
+    int consumed = 0;
+    if (sscanf(line, "%c %u%n", &tag, &seq, &consumed) != 2) {
+        worker->errors++;
+        return;
+    }
+    if (seq - worker->ackedSeq >= worker->nextSeq - worker->ackedSeq) return; // not one we are waiting for
+    Message *message = &worker->messages[seq & (MESSAGE_RING - 1)];
+    if (seq + 1 > worker->ackedSeq) worker->ackedSeq = seq + 1;
+
+    if (message->kind == MESSAGE_ORDERS) {
+        long now = nowNs();
+        char *cursor = line + consumed, *end;
+        for (int i = 0; i < message->count; ++i) {
+            int order = message->firstOrder + i;
+            long orderId = (tag == 'R') ? strtol(cursor, &end, 10) : 0;
+            if (tag != 'R' || end == cursor) { // rejected, nothing to poll for
+                worker->errors++;
+                finishOrder(worker, order, OUTCOME_REJECTED);
+                continue;
+            }
+            cursor = end;
+            worker->orderIds[order] = (int)orderId;
+            worker->acked++;
+            long latency = (now - worker->intendedNs[order]) / 1000;
+            recordLatency(&worker->ackLatency, latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency);
+        }
+    } else if (message->kind == MESSAGE_STATUS) {
+        if (tag == 'E') finishOrder(worker, message->firstOrder, OUTCOME_LOST); // retired too long ago, or never known
+        else if (tag == 'S' && sscanf(line + consumed, "%*d %31s", status) == 1) {
+            if (strcmp(status, "Delivered") == 0) finishOrder(worker, message->firstOrder, OUTCOME_DELIVERED);
+            else if (strcmp(status, "Cancelled") == 0) finishOrder(worker, message->firstOrder, OUTCOME_LOST);
+        }
+    }
+}
+
+// consumes every complete reply line that has arrived, 0 when the server closed the connection
+int readReplies(Worker *worker) {
+    while (1) {
+        int bytes_received = recv(worker->sock, worker->replies + worker->replyLen, sizeof(worker->replies) - 1 - worker->replyLen, 0);
+        if (bytes_received == -1 && errno == EINTR) continue;
+        if (bytes_received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (bytes_received <= 0) return 0;
+        worker->replyLen += bytes_received;
+        worker->replies[worker->replyLen] = '\0';
+
+        char *line = worker->replies;
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            handleReply(worker, line);
+            line = newline + 1;
+        }
+        worker->replyLen = strlen(line);
+        memmove(worker->replies, line, worker->replyLen);
+    }
+}
+
+int flushOut(Worker *worker) {
+    int sent = 0;
+    while (sent < worker->outLen) {
+        ssize_t written = send(worker->sock, worker->out + sent, worker->outLen - sent, MSG_NOSIGNAL);
+        if (written == -1 && errno == EINTR) continue;
+        if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (written <= 0) return 0;
+        sent += written;
+    }
+    memmove(worker->out, worker->out + sent, worker->outLen - sent);
+    worker->outLen -= sent;
+    return 1;
+}
+
+void *workerThread(void *arg) {
+    Worker *worker = (Worker *)arg;
+    seedRandom(worker->id);
+    int openLoop = worker->rate > 0;
+    long now = nowNs();
+    long nextArrival = now, nextSweep = now + STATUS_INTERVAL_MS * 1000000L, lastProgress = now;
+    int endSent = 0, lastFinished = 0;
+    int locations[2 * ORDER_BATCH_SIZE];
+
+    while (worker->finished < worker->orderCount || !endSent || worker->ackedSeq != worker->nextSeq) {
+        now = nowNs();
+        if (openLoop) {
+            // every arrival that is due goes out now, late ones keep their scheduled time
+            while (worker->sent < worker->orderCount && nextArrival <= now && canSend(worker, 64)) {
+                worker->intendedNs[worker->sent] = nextArrival;
+                pickLocation(&locations[0], &locations[1]);
+                sendOrders(worker, worker->sent, 1, locations);
+                worker->sent++;
+                worker->lastSentNs = now;
+                nextArrival += nextGapNs(worker);
+            }
+        } else {
+            while (worker->sent < worker->orderCount && worker->nextSeq - worker->ackedSeq < PIPELINE_WINDOW && canSend(worker, MESSAGE_SIZE * 2)) {
+                int count = worker->orderCount - worker->sent;
+                if (count > ORDER_BATCH_SIZE) count = ORDER_BATCH_SIZE;
+                for (int i = 0; i < count; ++i) {
+                    worker->intendedNs[worker->sent + i] = now;
+                    pickLocation(&locations[2 * i], &locations[2 * i + 1]);
+                }
+                sendOrders(worker, worker->sent, count, locations);
+                worker->sent += count;
+                worker->lastSentNs = now;
+            }
+        }
+        if (worker->sent == worker->orderCount && !endSent && canSend(worker, 64)) {
+            char message[64]; // end marker, the session ends when the connection closes
+            int len = snprintf(message, sizeof(message), "O %u -999 -999 %d\n", worker->nextSeq, worker->orderCount);
+            queueMessage(worker, MESSAGE_END, 0, 0, message, len);
+            endSent = 1;
+        }
+        if (now >= nextSweep) {
+            sweepStatus(worker);
+            nextSweep = now + STATUS_INTERVAL_MS * 1000000L;
+        }
+        if (worker->finished != lastFinished) {
+            lastFinished = worker->finished;
+            lastProgress = now;
+        } else if (worker->sent == worker->orderCount && now - lastProgress > DRAIN_TIMEOUT_S * 1000000000L) {
+            printf("worker %d: gave up on %d undelivered orders\n", worker->id, worker->orderCount - worker->finished);
+            break;
+        }
+        if (!flushOut(worker)) break;
+
+        long wake = nextSweep;
+        if (openLoop && worker->sent < worker->orderCount && nextArrival < wake) wake = nextArrival;
+        long waitNs = wake > now ? wake - now : 0;
+        struct timespec timeout = { waitNs / 1000000000L, waitNs % 1000000000L };
+        struct pollfd socketEvents = { worker->sock, POLLIN | (worker->outLen > 0 ? POLLOUT : 0), 0 };
+        if (ppoll(&socketEvents, 1, &timeout, NULL) > 0 && (socketEvents.revents & (POLLIN | POLLHUP | POLLERR))) {
+            if (!readReplies(worker)) {
+                printf("worker %d: server closed the connection\n", worker->id);
+                break;
+            }
+        }
     }
+    close(worker->sock);
+    return NULL;
+}
 
-    close(sock);
+void addHistogram(LatencyHistogram *into, const LatencyHistogram *from) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        into->counts[i] += from->counts[i];
+    }
+}
+
+void writeResults(const char *path, Worker *workers, int threadCount, double targetRate, long startNs) {
+    static LatencyHistogram histograms[2];
+    const char *metrics[2] = { "ack", "delivered" };
+    const double percentiles[5] = { 50, 90, 99, 99.9, 100 };
+    int errors = 0, delivered = 0, lost = 0;
+    long sendingNs = 1;
+    double elapsed = (nowNs() - startNs) / 1e9;
+    for (int i = 0; i < threadCount; ++i) {
+        if (workers[i].lastSentNs - startNs > sendingNs) sendingNs = workers[i].lastSentNs - startNs;
+        addHistogram(&histograms[0], &workers[i].ackLatency);
+        addHistogram(&histograms[1], &workers[i].deliveredLatency);
+        errors += workers[i].errors;
+        delivered += workers[i].delivered;
+        lost += workers[i].lost;
+    }
+    double achieved = histogramCount(&histograms[0]) / (sendingNs / 1e9); // over the send phase
+    printf("%d orders, %d threads, %s arrivals at %.1f/s (0 = closed loop), %s spread, %.1f orders/s acked, %d errors, %d delivered, %d lost or cancelled in %.2f s\n",
+           totalOrderAmount, threadCount, arrivalNames[arrival], targetRate, spreadNames[spread], achieved, errors, delivered, lost, elapsed);
+    for (int m = 0; m < 2; ++m) {
+        printf("%-9s latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n", metrics[m],
+               histogramPercentile(&histograms[m], 50) / 1e3, histogramPercentile(&histograms[m], 90) / 1e3,
+               histogramPercentile(&histograms[m], 99) / 1e3, histogramPercentile(&histograms[m], 99.9) / 1e3,
+               histogramPercentile(&histograms[m], 100) / 1e3);
+    }
+    if (path == NULL) return;
+
+    size_t length = strlen(path);
+    int json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+    FILE *file = fopen(path, json ? "w" : "a"); // csv rows of several runs go into one file
+    if (file == NULL) {
+        perror("Failed to open result file");
+        return;
+    }
+    if (json) {
+        fprintf(file, "{\"orders\": %d, \"threads\": %d, \"target_rate\": %.3f, \"arrival\": \"%s\", \"spread\": \"%s\", \"p\": %d, \"q\": %d,\n",
+                totalOrderAmount, threadCount, targetRate, arrivalNames[arrival], spreadNames[spread], p, q);
+        fprintf(file, " \"elapsed_s\": %.3f, \"achieved_rate\": %.3f, \"errors\": %d, \"lost\": %d, \"latency_ms\": {", elapsed, achieved, errors, lost);
+        for (int m = 0; m < 2; ++m) {
+            fprintf(file, "%s\n  \"%s\": {\"count\": %llu", m ? "," : "", metrics[m], (unsigned long long)histogramCount(&histograms[m]));
+            const char *names[5] = { "p50", "p90", "p99", "p999", "max" };
+            for (int i = 0; i < 5; ++i) {
+                fprintf(file, ", \"%s\": %.3f", names[i], histogramPercentile(&histograms[m], percentiles[i]) / 1e3);
+            }
+            fprintf(file, "}");
+        }
+        fprintf(file, "\n }}\n");
+    } else {
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0) {
+            fprintf(file, "metric,orders,threads,target_rate,arrival,spread,achieved_rate,errors,count,p50_ms,p90_ms,p99_ms,p999_ms,max_ms\n");
+        }
+        for (int m = 0; m < 2; ++m) {
+            fprintf(file, "%s,%d,%d,%.3f,%s,%s,%.3f,%d,%llu", metrics[m], totalOrderAmount, threadCount, targetRate,
+                    arrivalNames[arrival], spreadNames[spread], achieved, errors, (unsigned long long)histogramCount(&histograms[m]));
+            for (int i = 0; i < 5; ++i) {
+                fprintf(file, ",%.3f", histogramPercentile(&histograms[m], percentiles[i]) / 1e3);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
 }
- 
@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <immintrin.h>
+#include "complexMatrix.h"
+
+#define SINGULAR_PIVOT 1e-12
+
+// one parallel loop over [0, end) handed out in chunk sized ranges. the submitting thread
+// waits until every chunk finished and no helper still holds the job
+typedef struct MatrixJob {
+    void (*body)(void *ctx, int begin, int end);
+    void *ctx;
+    int end;
+    int chunk;
+    atomic_int next; // first index not handed out yet
+    atomic_int pending; // chunks not finished yet
+    int users; // helpers inside the job, guarded by matrixPoolLock
+    struct MatrixJob *nextJob;
+} MatrixJob;
+
+pthread_mutex_t matrixPoolLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t matrixWorkReady = PTHREAD_COND_INITIALIZER;
+pthread_cond_t matrixJobDone = PTHREAD_COND_INITIALIZER;
+MatrixJob *matrixJobs = NULL;
+pthread_t matrixThreads[MAX_MATRIX_THREADS];
+int matrixThreadCount = 0;
+int matrixPoolStopping = 0;
+
+// y += a * x over n complex numbers in split form, every multiply, elimination and
+// scaling step of the module ends up here
+typedef void (*AxpyKernel)(int n, double ar, double ai, const double *xre, const double *xim, double *yre, double *yim);
+
+AxpyKernel axpyKernel = NULL;
+MatrixKernel activeKernel = KERNEL_AUTO;
+
+void axpyScalar(int n, double ar, double ai, const double *xre, const double *xim, double *yre, double *yim) {
+    for (int j = 0; j < n; ++j) {
+        double xr = xre[j], xi = xim[j];
+        yre[j] += ar * xr - ai * xi;
+        yim[j] += ar * xi + ai * xr;
+    }
+}
+
+__attribute__((target("sse2")))
+void axpySse2(int n, double ar, double ai, const double *xre, const double *xim, double *yre, double *yim) {
+    __m128d vr = _mm_set1_pd(ar), vi = _mm_set1_pd(ai);
+    int j = 0;
+    for (; j + 2 <= n; j += 2) {
+        __m128d xr = _mm_loadu_pd(xre + j), xi = _mm_loadu_pd(xim + j);
+        __m128d yr = _mm_loadu_pd(yre + j), yi = _mm_loadu_pd(yim + j);
+        yr = _mm_add_pd(yr, _mm_sub_pd(_mm_mul_pd(vr, xr), _mm_mul_pd(vi, xi)));
+        yi = _mm_add_pd(yi, _mm_add_pd(_mm_mul_pd(vr, xi), _mm_mul_pd(vi, xr)));
+        _mm_storeu_pd(yre + j, yr);
+        _mm_storeu_pd(yim + j, yi);
+    }
+    axpyScalar(n - j, ar, ai, xre + j, xim + j, yre + j, yim + j);
+}
+
+__attribute__((target("avx2,fma")))
+void axpyAvx2(int n, double ar, double ai, const double *xre, const double *xim, double *yre, double *yim) {
+    __m256d vr = _mm256_set1_pd(ar), vi = _mm256_set1_pd(ai);
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m256d xr = _mm256_loadu_pd(xre + j), xi = _mm256_loadu_pd(xim + j);
+        __m256d yr = _mm256_loadu_pd(yre + j), yi = _mm256_loadu_pd(yim + j);
+        yr = _mm256_fnmadd_pd(vi, xi, _mm256_fmadd_pd(vr, xr, yr));
+        yi = _mm256_fmadd_pd(vi, xr, _mm256_fmadd_pd(vr, xi, yi));
+        _mm256_storeu_pd(yre + j, yr);
+        _mm256_storeu_pd(yim + j, yi);
+    }
+    axpyScalar(n - j, ar, ai, xre + j, xim + j, yre + j, yim + j);
+}
+
+int setMatrixKernel(MatrixKernel kernel) {
+    __builtin_cpu_init();
+    if (kernel == KERNEL_AUTO) {
+        kernel = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? KERNEL_AVX2 : KERNEL_SSE2;
+    }
+    switch (kernel) {
+    case KERNEL_AVX2:
+        if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma")) return -1;
+        axpyKernel = axpyAvx2;
+        break;
+    case KERNEL_SSE2:
+        axpyKernel = axpySse2;
+        break;
+    default:
+        axpyKernel = axpyScalar;
+        kernel = KERNEL_SCALAR;
+    }
+    activeKernel = kernel;
+    return 0;
+}
+
+const char *matrixKernelName() {
+    switch (activeKernel) {
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_SSE2: return "sse2";
+    case KERNEL_SCALAR: return "scalar";
+    default: return "auto";
+    }
+}
+
+void complexAxpy(int n, double ar, double ai, const double *xre, const double *xim, double *yre, double *yim) {
+    if (axpyKernel == NULL) setMatrixKernel(KERNEL_AUTO);
+    axpyKernel(n, ar, ai, xre, xim, yre, yim);
+}
+
+void runJobChunks(MatrixJob *job) {
+    int begin;
+    while ((begin = atomic_fetch_add(&job->next, job->chunk)) < job->end) {
+        int end = begin + job->chunk < job->end ? begin + job->chunk : job->end;
+        job->body(job->ctx, begin, end);
+        if (atomic_fetch_sub(&job->pending, 1) == 1) {
+            pthread_mutex_lock(&matrixPoolLock);
+            pthread_cond_broadcast(&matrixJobDone);
+            pthread_mutex_unlock(&matrixPoolLock);
+        }
+    }
+}
+
+void *matrixPoolThread(void *arg) {
+    pthread_mutex_lock(&matrixPoolLock);
+    while (!matrixPoolStopping) {
+        MatrixJob *job = matrixJobs;
+        while (job != NULL && atomic_load(&job->next) >= job->end) {
+            job = job->nextJob;
+        }
+        if (job == NULL) {
+            pthread_cond_wait(&matrixWorkReady, &matrixPoolLock);
+            continue;
+        }
+        job->users++;
+        pthread_mutex_unlock(&matrixPoolLock);
+        runJobChunks(job);
+        pthread_mutex_lock(&matrixPoolLock);
+        if (--job->users == 0) pthread_cond_broadcast(&matrixJobDone);
+    }
+    pthread_mutex_unlock(&matrixPoolLock);
+    return NULL;
+}
+
+int startMatrixPool(int threads) {
+    if (threads > MAX_MATRIX_THREADS) threads = MAX_MATRIX_THREADS;
+    matrixPoolStopping = 0;
+    for (matrixThreadCount = 0; matrixThreadCount < threads; ++matrixThreadCount) {
+        if (pthread_create(&matrixThreads[matrixThreadCount], NULL, matrixPoolThread, NULL) != 0) return -1;
+    }
+    return 0;
+}
+
+void stopMatrixPool() {
+    pthread_mutex_lock(&matrixPoolLock);
+    matrixPoolStopping = 1;
+    pthread_cond_broadcast(&matrixWorkReady);
+    pthread_mutex_unlock(&matrixPoolLock);
+    for (int i = 0; i < matrixThreadCount; ++i) {
+        pthread_join(matrixThreads[i], NULL);
+    }
+    matrixThreadCount = 0;
+}
+
+int matrixPoolSize() {
+    return matrixThreadCount;
+}
+
+// runs body over [0, end) in chunk sized ranges, on the pool when there is one and the
+// loop is long enough to be worth the hand off
+void parallelFor(int end, int chunk, void (*body)(void *ctx, int begin, int end), void *ctx) {
+    if (matrixThreadCount == 0 || end <= chunk) {
+        body(ctx, 0, end);
+        return;
+    }
+    MatrixJob job;
+    job.body = body;
+    job.ctx = ctx;
+    job.end = end;
+    job.chunk = chunk;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.pending, (end + chunk - 1) / chunk);
+    job.users = 0;
+
+    pthread_mutex_lock(&matrixPoolLock);
+    job.nextJob = matrixJobs;
+    matrixJobs = &job;
+    pthread_cond_broadcast(&matrixWorkReady);
+    pthread_mutex_unlock(&matrixPoolLock);
+
+    runJobChunks(&job);
+
+    pthread_mutex_lock(&matrixPoolLock);
+    while (atomic_load(&job.pending) > 0 || job.users > 0) {
+        pthread_cond_wait(&matrixJobDone, &matrixPoolLock);
+    }
+    MatrixJob **link = &matrixJobs;
+    while (*link != &job) link = &(*link)->nextJob;
+    *link = job.nextJob;
+    pthread_mutex_unlock(&matrixPoolLock);
+}
+
+int initComplexMatrix(ComplexMatrix *m, int rows, int cols) {
+    m->capacity = 0;
+    m->re = m->im = NULL;
+    return resizeComplexMatrix(m, rows, cols);
+}
+
+int resizeComplexMatrix(ComplexMatrix *m, int rows, int cols) {
+    int stride = (cols + 3) & ~3;
+    size_t needed = (size_t)rows * stride;
+    if (needed > m->capacity || m->re == NULL) {
+        freeComplexMatrix(m);
+        size_t bytes = sizeof(double) * (needed ? needed : 4);
+        m->re = (double *)aligned_alloc(32, bytes);
+        m->im = (double *)aligned_alloc(32, bytes);
+        if (m->re == NULL || m->im == NULL) {
+            freeComplexMatrix(m);
+            return -1;
+        }
+        m->capacity = needed;
+    }
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = stride;
+    memset(m->re, 0, sizeof(double) * needed);
+    memset(m->im, 0, sizeof(double) * needed);
+    return 0;
+}
+
+void freeComplexMatrix(ComplexMatrix *m) {
+    free(m->re);
+    free(m->im);
+    m->re = m->im = NULL;
+    m->capacity = 0;
+}
+
+Complex matrixGet(const ComplexMatrix *m, int i, int j) {
+    Complex value;
+    value.real = m->re[i * m->stride + j];
+    value.imag = m->im[i * m->stride + j];
+    return value;
+}
+
+void matrixSet(ComplexMatrix *m, int i, int j, Complex value) {
+    m->re[i * m->stride + j] = value.real;
+    m->im[i * m->stride + j] = value.imag;
+}
+
+typedef struct {
+    const ComplexMatrix *a;
+    const ComplexMatrix *b;
+    ComplexMatrix *out;
+} MatrixTask;
+
+// rows [begin, end) of a, walked in 32x32 tiles so both sides stay in cache
+void transposeRows(void *ctx, int begin, int end) {
+    MatrixTask *task = (MatrixTask *)ctx;
+    const ComplexMatrix *a = task->a;
+    ComplexMatrix *out = task->out;
+    for (int jj = 0; jj < a->cols; jj += 32) {
+        int jEnd = jj + 32 < a->cols ? jj + 32 : a->cols;
+        for (int i = begin; i < end; ++i) {
+            for (int j = jj; j < jEnd; ++j) {
+                out->re[j * out->stride + i] = a->re[i * a->stride + j];
+                out->im[j * out->stride + i] = -a->im[i * a->stride + j];
+            }
+        }
+    }
+}
+
+void conjugateTranspose(const ComplexMatrix *a, ComplexMatrix *out) {
+    MatrixTask task = { a, NULL, out };
+    int chunk = a->rows * a->cols >= MATRIX_PARALLEL_MIN * MATRIX_PARALLEL_MIN ? 32 : a->rows;
+    parallelFor(a->rows, chunk, transposeRows, &task);
+}
+
+// rows [begin, end) of out = a * b. a MATRIX_BLOCK_K x MATRIX_BLOCK_COLS panel of b is swept
+// by every row of the range before moving on, each a[i][k] scales a row of the panel into out
+void multiplyRows(void *ctx, int begin, int end) {
+    MatrixTask *task = (MatrixTask *)ctx;
+    const ComplexMatrix *a = task->a, *b = task->b;
+    ComplexMatrix *out = task->out;
+    for (int i = begin; i < end; ++i) {
+        memset(out->re + i * out->stride, 0, sizeof(double) * out->cols);
+        memset(out->im + i * out->stride, 0, sizeof(double) * out->cols);
+    }
+    for (int jj = 0; jj < b->cols; jj += MATRIX_BLOCK_COLS) {
+        int width = jj + MATRIX_BLOCK_COLS < b->cols ? MATRIX_BLOCK_COLS : b->cols - jj;
+        for (int kk = 0; kk < a->cols; kk += MATRIX_BLOCK_K) {
+            int kEnd = kk + MATRIX_BLOCK_K < a->cols ? kk + MATRIX_BLOCK_K : a->cols;
+            for (int i = begin; i < end; ++i) {
+                double *outRe = out->re + i * out->stride + jj, *outIm = out->im + i * out->stride + jj;
+                for (int k = kk; k < kEnd; ++k) {
+                    double ar = a->re[i * a->stride + k], ai = a->im[i * a->stride + k];
+                    if (ar == 0.0 && ai == 0.0) continue;
+                    complexAxpy(width, ar, ai, b->re + k * b->stride + jj, b->im + k * b->stride + jj, outRe, outIm);
+                }
+            }
+        }
+    }
+}
+
+int complexMultiply(const ComplexMatrix *a, const ComplexMatrix *b, ComplexMatrix *out) {
+    if (a->cols != b->rows || out->rows != a->rows || out->cols != b->cols) return -1;
+    MatrixTask task = { a, b, out };
+    int large = out->rows >= MATRIX_PARALLEL_MIN || (double)out->rows * out->cols * a->cols >= 1e6;
+    parallelFor(out->rows, large ? MATRIX_BLOCK_ROWS : out->rows, multiplyRows, &task);
+    return 0;
+}
+
+void swapRows(ComplexMatrix *m, int r1, int r2) {
+    for (int j = 0; j < m->cols; ++j) {
+        double re = m->re[r1 * m->stride + j], im = m->im[r1 * m->stride + j];
+        m->re[r1 * m->stride + j] = m->re[r2 * m->stride + j];
+        m->im[r1 * m->stride + j] = m->im[r2 * m->stride + j];
+        m->re[r2 * m->stride + j] = re;
+        m->im[r2 * m->stride + j] = im;
+    }
+}
+
+// row *= s, done as row = 0 + s * copy through the axpy kernel
+void scaleRow(ComplexMatrix *m, int row, int from, double sr, double si, double *scratchRe, double *scratchIm) {
+    int n = m->cols - from;
+    double *re = m->re + row * m->stride + from, *im = m->im + row * m->stride + from;
+    memcpy(scratchRe, re, sizeof(double) * n);
+    memcpy(scratchIm, im, sizeof(double) * n);
+    memset(re, 0, sizeof(double) * n);
+    memset(im, 0, sizeof(double) * n);
+    complexAxpy(n, sr, si, scratchRe, scratchIm, re, im);
+}
+
+typedef struct {
+    ComplexMatrix *a;
+    ComplexMatrix *out;
+    int pivot;
+} EliminationTask;
+
+// clears column pivot from rows [begin, end) using the already scaled pivot row
+void eliminateRows(void *ctx, int begin, int end) {
+    EliminationTask *task = (EliminationTask *)ctx;
+    ComplexMatrix *a = task->a, *out = task->out;
+    int p = task->pivot, n = a->rows;
+    for (int r = begin; r < end; ++r) {
+        if (r == p) continue;
+        double fr = a->re[r * a->stride + p], fi = a->im[r * a->stride + p];
+        if (fr == 0.0 && fi == 0.0) continue;
+        complexAxpy(n - p, -fr, -fi, a->re + p * a->stride + p, a->im + p * a->stride + p,
+                    a->re + r * a->stride + p, a->im + r * a->stride + p);
+        complexAxpy(n, -fr, -fi, out->re + p * out->stride, out->im + p * out->stride,
+                    out->re + r * out->stride, out->im + r * out->stride);
+    }
+}
+
+// Gauss-Jordan with partial pivoting on [a | out], out starts as the identity
+int complexInverse(ComplexMatrix *a, ComplexMatrix *out, double *scratch) {
+    int n = a->rows;
+    if (a->cols != n || out->rows != n || out->cols != n) return -1;
+    double *scratchRe = scratch, *scratchIm = scratch + n;
+
+    for (int i = 0; i < n; ++i) {
+        memset(out->re + i * out->stride, 0, sizeof(double) * n);
+        memset(out->im + i * out->stride, 0, sizeof(double) * n);
+        out->re[i * out->stride + i] = 1.0;
+    }
+
+    for (int p = 0; p < n; ++p) {
+        int pivot = p;
+        double best = 0.0;
+        for (int r = p; r < n; ++r) {
+            double magnitude = hypot(a->re[r * a->stride + p], a->im[r * a->stride + p]);
+            if (magnitude > best) {
+                best = magnitude;
+                pivot = r;
+            }
+        }
+        if (best < SINGULAR_PIVOT) return -1;
+        if (pivot != p) {
+            swapRows(a, p, pivot);
+            swapRows(out, p, pivot);
+        }
+
+        // 1 / pivot
+        double pr = a->re[p * a->stride + p], pi = a->im[p * a->stride + p];
+        double norm = pr * pr + pi * pi;
+        scaleRow(a, p, p, pr / norm, -pi / norm, scratchRe, scratchIm);
+        scaleRow(out, p, 0, pr / norm, -pi / norm, scratchRe, scratchIm);
+
+        EliminationTask task = { a, out, p };
+        parallelFor(n, n >= MATRIX_PARALLEL_MIN ? MATRIX_BLOCK_ROWS : n, eliminateRows, &task);
+    }
+    return 0;
+}
+
+int initMatrixWorkspace(MatrixWorkspace *work) {
+    work->scratch = NULL;
+    work->scratchRows = 0;
+    int failed = initComplexMatrix(&work->adjoint, 1, 1);
+    failed |= initComplexMatrix(&work->gram, 1, 1);
+    failed |= initComplexMatrix(&work->gramInverse, 1, 1);
+    if (failed) freeMatrixWorkspace(work);
+    return failed ? -1 : 0;
+}
+
+void freeMatrixWorkspace(MatrixWorkspace *work) {
+    freeComplexMatrix(&work->adjoint);
+    freeComplexMatrix(&work->gram);
+    freeComplexMatrix(&work->gramInverse);
+    free(work->scratch);
+    work->scratch = NULL;
+    work->scratchRows = 0;
+}
+
+// wide a (rows <= cols): a^H (a a^H)^-1, tall a: (a^H a)^-1 a^H.
+// the gram matrix is always the small side so it has full rank when a does
+int pseudoInverse(const ComplexMatrix *a, ComplexMatrix *out, MatrixWorkspace *work) {
+    if (out->rows != a->cols || out->cols != a->rows) return -1;
+    int small = a->rows < a->cols ? a->rows : a->cols;
+    if (small > work->scratchRows) {
+        double *scratch = (double *)realloc(work->scratch, sizeof(double) * small * 2);
+        if (scratch == NULL) return -1;
+        work->scratch = scratch;
+        work->scratchRows = small;
+    }
+    ComplexMatrix *adjoint = &work->adjoint, *gram = &work->gram, *gramInverse = &work->gramInverse;
+    if (resizeComplexMatrix(adjoint, a->cols, a->rows) == -1
+            || resizeComplexMatrix(gram, small, small) == -1
+            || resizeComplexMatrix(gramInverse, small, small) == -1) {
+        return -1;
+    }
+
+    conjugateTranspose(a, adjoint);
+    if (a->rows <= a->cols) {
+        return (complexMultiply(a, adjoint, gram)
+             || complexInverse(gram, gramInverse, work->scratch)
+             || complexMultiply(adjoint, gramInverse, out)) ? -1 : 0;
+    }
+    return (complexMultiply(adjoint, a, gram)
+         || complexInverse(gram, gramInverse, work->scratch)
+         || complexMultiply(gramInverse, adjoint, out)) ? -1 : 0;
+}
+
+// 8 real flops per complex multiply-add: gram and final product are m*m*n each,
+// Gauss-Jordan touches about 1.5*m columns of m-1 rows for each of m pivots
+double pseudoInverseFlops(int rows, int cols) {
+    double m = rows < cols ? rows : cols;
+    double n = rows < cols ? cols : rows;
+    return 8.0 * (2.0 * m * m * n + 1.5 * m * m * (m - 1));
+}
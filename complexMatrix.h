@@ -0,0 +1,69 @@
+#ifndef COMPLEX_MATRIX_H
+#define COMPLEX_MATRIX_H
+
+#include <stddef.h>
+
+#define MATRIX_BLOCK_ROWS 32 // output rows one pool task computes
+#define MATRIX_BLOCK_K 64 // rows of b kept hot while they are swept
+#define MATRIX_BLOCK_COLS 256 // columns of b and out per sweep, 64 x 256 complex = 256 KB
+#define MATRIX_PARALLEL_MIN 128 // smaller matrices stay on the calling thread
+#define MAX_MATRIX_THREADS 64
+
+typedef struct {
+    double real;
+    double imag;
+} Complex;
+
+// split storage: real and imaginary parts in two row major arrays. rows are padded to
+// a multiple of 4 doubles and the padding stays zero, so vector loads never straddle rows
+typedef struct {
+    int rows;
+    int cols;
+    int stride;
+    size_t capacity; // doubles allocated per part, lets resizeComplexMatrix reuse memory
+    double *re;
+    double *im;
+} ComplexMatrix;
+
+// the intermediates of pseudoInverse, kept by the caller between calls so an order does
+// not allocate once the workspace has grown to its largest recipe
+typedef struct {
+    ComplexMatrix adjoint;
+    ComplexMatrix gram;
+    ComplexMatrix gramInverse;
+    double *scratch; // pivot row copies of complexInverse, 2 * scratchRows doubles
+    int scratchRows;
+} MatrixWorkspace;
+
+typedef enum {
+    KERNEL_AUTO,
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+} MatrixKernel;
+
+int initComplexMatrix(ComplexMatrix *m, int rows, int cols); // zero filled, -1 when out of memory
+int resizeComplexMatrix(ComplexMatrix *m, int rows, int cols); // zero filled, keeps the buffers when they are big enough
+void freeComplexMatrix(ComplexMatrix *m);
+Complex matrixGet(const ComplexMatrix *m, int i, int j);
+void matrixSet(ComplexMatrix *m, int i, int j, Complex value);
+
+void conjugateTranspose(const ComplexMatrix *a, ComplexMatrix *out); // tiled
+int complexMultiply(const ComplexMatrix *a, const ComplexMatrix *b, ComplexMatrix *out); // cache blocked
+int complexInverse(ComplexMatrix *a, ComplexMatrix *out, double *scratch); // Gauss-Jordan, a is overwritten, scratch holds 2 * rows doubles. -1 when singular
+int initMatrixWorkspace(MatrixWorkspace *work); // -1 when out of memory
+void freeMatrixWorkspace(MatrixWorkspace *work);
+int pseudoInverse(const ComplexMatrix *a, ComplexMatrix *out, MatrixWorkspace *work); // Moore-Penrose, out is cols x rows
+double pseudoInverseFlops(int rows, int cols); // nominal real flops of one pseudoInverse
+
+// the inner loops run on the widest kernel the cpu supports unless one is forced
+int setMatrixKernel(MatrixKernel kernel); // -1 when the cpu lacks it
+const char *matrixKernelName();
+
+// helper threads shared by every caller, large multiplies, transposes and eliminations are
+// split into row ranges and the calling thread works on its own job too
+int startMatrixPool(int threads);
+void stopMatrixPool();
+int matrixPoolSize();
+
+#endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "deadlineHeap.h"
+
+void initDeadlineHeap(DeadlineHeap *heap) {
+    heap->items = (Order **)malloc(sizeof(Order *) * DEADLINE_HEAP_MIN_SIZE);
+    if (heap->items == NULL) {
+        perror("Failed to allocate deadline heap");
+        exit(1);
+    }
+    heap->count = 0;
+    heap->capacity = DEADLINE_HEAP_MIN_SIZE;
+}
+
+void freeDeadlineHeap(DeadlineHeap *heap) {
+    free(heap->items);
+    heap->items = NULL;
+}
+
+int dueBefore(const Order *a, const Order *b) {
+    return (int32_t)(a->dueUs - b->dueUs) < 0;
+}
+
+void placeDeadline(DeadlineHeap *heap, int slot, Order *order) {
+    heap->items[slot] = order;
+    order->heapSlot = slot;
+}
+
+void raiseDeadline(DeadlineHeap *heap, int slot) {
+    Order *order = heap->items[slot];
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (!dueBefore(order, heap->items[parent])) break;
+        placeDeadline(heap, slot, heap->items[parent]);
+        slot = parent;
+    }
+    placeDeadline(heap, slot, order);
+}
+
+void sinkDeadline(DeadlineHeap *heap, int slot) {
+    Order *order = heap->items[slot];
+    while (1) {
+        int child = 2 * slot + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && dueBefore(heap->items[child + 1], heap->items[child])) child++;
+        if (!dueBefore(heap->items[child], order)) break;
+        placeDeadline(heap, slot, heap->items[child]);
+        slot = child;
+    }
+    placeDeadline(heap, slot, order);
+}
+
+int pushDeadline(DeadlineHeap *heap, Order *order) {
+    if (heap->count == heap->capacity) {
+        Order **items = (Order **)realloc(heap->items, sizeof(Order *) * heap->capacity * 2);
+        if (items == NULL) return -1;
+        heap->items = items;
+        heap->capacity *= 2;
+    }
+    heap->items[heap->count] = order;
+    raiseDeadline(heap, heap->count++);
+    return 0;
+}
+
+// the last leaf fills the hole, then moves whichever way restores the order
+void removeDeadline(DeadlineHeap *heap, Order *order) {
+    int slot = order->heapSlot;
+    Order *last = heap->items[--heap->count];
+    if (slot == heap->count) return;
+    placeDeadline(heap, slot, last);
+    if (slot > 0 && dueBefore(last, heap->items[(slot - 1) / 2])) raiseDeadline(heap, slot);
+    else sinkDeadline(heap, slot);
+}
+
+Order *popEarliest(DeadlineHeap *heap) {
+    if (heap->count == 0) return NULL;
+    Order *order = heap->items[0];
+    removeDeadline(heap, order);
+    return order;
+}
+
+// the array's last entry is a leaf, so taking it leaves the rest a heap
+Order *popLatest(DeadlineHeap *heap) {
+    if (heap->count == 0) return NULL;
+    return heap->items[--heap->count];
+}
@@ -0,0 +1,24 @@
+#ifndef DEADLINE_HEAP_H
+#define DEADLINE_HEAP_H
+
+#include "order.h"
+
+#define DEADLINE_HEAP_MIN_SIZE 16
+
+// binary min heap of orders by dueUs, earliest first. each order remembers its position in
+// heapSlot so one can be taken out from the middle. no lock, the owner of the heap holds one
+typedef struct {
+    Order **items;
+    int count;
+    int capacity;
+} DeadlineHeap;
+
+void initDeadlineHeap(DeadlineHeap *heap);
+void freeDeadlineHeap(DeadlineHeap *heap);
+int dueBefore(const Order *a, const Order *b); // dueUs wraps with the order clock, compared as a difference
+int pushDeadline(DeadlineHeap *heap, Order *order); // -1 when out of memory
+Order *popEarliest(DeadlineHeap *heap); // NULL when empty
+Order *popLatest(DeadlineHeap *heap); // a leaf, one of the later deadlines. NULL when empty
+void removeDeadline(DeadlineHeap *heap, Order *order);
+
+#endif
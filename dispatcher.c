@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dispatcher.h"
+
+void initDispatcher(Dispatcher *dispatcher) {
+    pthread_mutex_init(&dispatcher->lock, NULL);
+    pthread_cond_init(&dispatcher->orderReady, NULL);
+    initSpatialIndex(&dispatcher->index, DISPATCH_CELL, DISPATCH_GRID);
+    initDeadlineHeap(&dispatcher->due);
+    dispatcher->waiting = 0;
+}
+
+void destroyDispatcher(Dispatcher *dispatcher) {
+    freeSpatialIndex(&dispatcher->index);
+    freeDeadlineHeap(&dispatcher->due);
+    pthread_cond_destroy(&dispatcher->orderReady);
+    pthread_mutex_destroy(&dispatcher->lock);
+}
+
+double stopDistance(int fromX, int fromY, const Order *to) {
+    return hypot(to->customerX - fromX, to->customerY - fromY);
+}
+
+void addReadyOrder(Dispatcher *dispatcher, Order *order) {
+    pthread_mutex_lock(&dispatcher->lock);
+    if (insertSpatial(&dispatcher->index, order) == -1 || pushDeadline(&dispatcher->due, order) == -1) {
+        perror("Failed to index ready order");
+        exit(1);
+    }
+    dispatcher->waiting++;
+    pthread_cond_signal(&dispatcher->orderReady);
+    pthread_mutex_unlock(&dispatcher->lock);
+}
+
+// lock held, at least one order waiting
+int fillBag(Dispatcher *dispatcher, Order **bag, int capacity) {
+    Order *seed = popEarliest(&dispatcher->due);
+    removeSpatial(&dispatcher->index, seed);
+    bag[0] = seed;
+
+    int found = takeNearestOrders(&dispatcher->index, seed->customerX, seed->customerY, capacity - 1, bag + 1);
+    for (int i = 1; i <= found; ++i) {
+        removeDeadline(&dispatcher->due, bag[i]);
+    }
+    dispatcher->waiting -= found + 1;
+    return found + 1;
+}
+
+int takeBag(Dispatcher *dispatcher, Order **bag, int capacity, atomic_int *leave) {
+    if (capacity > MAX_BAG_STOPS) capacity = MAX_BAG_STOPS;
+    pthread_mutex_lock(&dispatcher->lock);
+    while (dispatcher->waiting == 0 && !atomic_load(leave)) {
+        pthread_cond_wait(&dispatcher->orderReady, &dispatcher->lock);
+    }
+    int count = atomic_load(leave) ? 0 : fillBag(dispatcher, bag, capacity);
+    pthread_mutex_unlock(&dispatcher->lock);
+    return count;
+}
+
+int tryTakeBag(Dispatcher *dispatcher, Order **bag, int capacity) {
+    if (capacity > MAX_BAG_STOPS) capacity = MAX_BAG_STOPS;
+    pthread_mutex_lock(&dispatcher->lock);
+    int count = (dispatcher->waiting == 0) ? 0 : fillBag(dispatcher, bag, capacity);
+    pthread_mutex_unlock(&dispatcher->lock);
+    return count;
+}
+
+void wakeCouriers(Dispatcher *dispatcher) {
+    pthread_mutex_lock(&dispatcher->lock);
+    pthread_cond_broadcast(&dispatcher->orderReady);
+    pthread_mutex_unlock(&dispatcher->lock);
+}
+
+int readyOrders(Dispatcher *dispatcher) {
+    return __atomic_load_n(&dispatcher->waiting, __ATOMIC_RELAXED);
+}
+
+// length of shop -> bag[0] -> ... -> bag[count - 1] -> shop
+double tourLength(Order **bag, int count) {
+    double length = stopDistance(0, 0, bag[0]) + stopDistance(0, 0, bag[count - 1]);
+    for (int i = 1; i < count; ++i) {
+        length += stopDistance(bag[i - 1]->customerX, bag[i - 1]->customerY, bag[i]);
+    }
+    return length;
+}
+
+// nearest neighbour from the shop, then 2-opt reversals until no swap shortens the tour
+double planRoute(Order **bag, int count) {
+    if (count <= 0) return 0.0;
+    int x = 0, y = 0;
+    for (int i = 0; i < count; ++i) {
+        int best = i;
+        for (int j = i + 1; j < count; ++j) {
+            if (stopDistance(x, y, bag[j]) < stopDistance(x, y, bag[best])) best = j;
+        }
+        Order *swap = bag[i];
+        bag[i] = bag[best];
+        bag[best] = swap;
+        x = bag[i]->customerX;
+        y = bag[i]->customerY;
+    }
+
+    // stop k sits between (k - 1) and (k + 1), the shop is at -1 and count
+    int improved = 1;
+    while (improved) {
+        improved = 0;
+        for (int i = 0; i < count - 1; ++i) {
+            for (int j = i + 1; j < count; ++j) {
+                int beforeX = (i == 0) ? 0 : bag[i - 1]->customerX, beforeY = (i == 0) ? 0 : bag[i - 1]->customerY;
+                int afterX = (j == count - 1) ? 0 : bag[j + 1]->customerX, afterY = (j == count - 1) ? 0 : bag[j + 1]->customerY;
+                double now = stopDistance(beforeX, beforeY, bag[i]) + stopDistance(afterX, afterY, bag[j]);
+                double reversed = stopDistance(beforeX, beforeY, bag[j]) + stopDistance(afterX, afterY, bag[i]);
+                if (reversed + 1e-9 < now) {
+                    for (int a = i, b = j; a < b; ++a, --b) {
+                        Order *swap = bag[a];
+                        bag[a] = bag[b];
+                        bag[b] = swap;
+                    }
+                    improved = 1;
+                }
+            }
+        }
+    }
+    return tourLength(bag, count);
+}
@@ -0,0 +1,35 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "order.h"
+#include "spatialIndex.h"
+#include "deadlineHeap.h"
+
+#define DISPATCH_CELL 4 // customer coordinate units per grid cell side
+#define DISPATCH_GRID 32 // cells per side, centred on the shop, outer cells take everything beyond
+#define MAX_BAG_STOPS 16
+
+// baked orders waiting for a courier. the spatial index finds the ones close to each other,
+// the deadline heap knows which one is due first. a courier's bag is the order with the
+// earliest deadline plus its nearest neighbours
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t orderReady;
+    SpatialIndex index;
+    DeadlineHeap due; // bagged neighbours are taken out of the middle
+    int waiting;
+} Dispatcher;
+
+void initDispatcher(Dispatcher *dispatcher);
+void destroyDispatcher(Dispatcher *dispatcher);
+void addReadyOrder(Dispatcher *dispatcher, Order *order);
+int takeBag(Dispatcher *dispatcher, Order **bag, int capacity, atomic_int *leave); // blocks until an order waits, 0 once *leave is set
+void wakeCouriers(Dispatcher *dispatcher); // after setting a leave flag
+int tryTakeBag(Dispatcher *dispatcher, Order **bag, int capacity); // 0 when nothing waits
+int readyOrders(Dispatcher *dispatcher); // without the lock, for metrics
+double planRoute(Order **bag, int count); // reorders the stops, returns the tour length from and back to the shop
+double stopDistance(int fromX, int fromY, const Order *to);
+
+#endif
@@ -0,0 +1,300 @@
+#define _GNU_SOURCE // IOV_MAX
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include "eventLog.h"
+
+#define RING_FREE 0
+#define RING_OWNED 1
+#define RING_RETIRED 2 // its thread exited, free again once the writer drained it
+
+typedef struct {
+    _Atomic uint64_t head; // bytes appended, only the owning thread moves it
+    _Atomic uint64_t tail; // bytes written to the file, only the writer moves it
+    atomic_int state;
+    uint32_t id;
+    char bytes[LOG_RING_BYTES];
+} LogRing;
+
+LogRing *logRings[MAX_LOG_RINGS];
+atomic_int logRingCount;
+atomic_int logRunning;
+atomic_int logStopping;
+atomic_int writerIdle; // the writer found every ring empty and waits without a timeout
+_Atomic uint64_t logLostBytes; // records the writer could not get into the file or no ring took
+int logFd = -1;
+pthread_t logWriter;
+pthread_key_t logRingKey;
+pthread_mutex_t logRingLock = PTHREAD_MUTEX_INITIALIZER; // only taken when a thread logs for the first time
+__thread LogRing *threadRing;
+__thread int threadRingless; // claimRing found none, the thread's records are counted as lost
+pthread_mutex_t writerLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t writerWake = PTHREAD_COND_INITIALIZER; // a ring got half full, or the first record after idle
+
+long logNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void retireRing(void *ring) {
+    atomic_store_explicit(&((LogRing *)ring)->state, RING_RETIRED, memory_order_release);
+}
+
+// a free ring of a finished thread, or a new one. NULL once MAX_LOG_RINGS threads log at the same time
+LogRing *claimRing() {
+    pthread_mutex_lock(&logRingLock);
+    LogRing *ring = NULL;
+    int count = atomic_load(&logRingCount);
+    for (int i = 0; i < count && ring == NULL; ++i) {
+        int expected = RING_FREE;
+        if (atomic_compare_exchange_strong(&logRings[i]->state, &expected, RING_OWNED)) ring = logRings[i];
+    }
+    if (ring == NULL && count < MAX_LOG_RINGS) {
+        ring = (LogRing *)malloc(sizeof(LogRing));
+        if (ring != NULL) {
+            atomic_init(&ring->head, 0);
+            atomic_init(&ring->tail, 0);
+            atomic_init(&ring->state, RING_OWNED);
+            ring->id = count;
+            logRings[count] = ring;
+            atomic_store(&logRingCount, count + 1); // the writer only looks at published rings
+        }
+    }
+    pthread_mutex_unlock(&logRingLock);
+    if (ring != NULL) pthread_setspecific(logRingKey, ring);
+    return ring;
+}
+
+// when a ring crosses half full or the writer is idle, a busy writer otherwise wakes every LOG_FLUSH_INTERVAL_NS
+void wakeWriter() {
+    pthread_mutex_lock(&writerLock);
+    pthread_cond_signal(&writerWake);
+    pthread_mutex_unlock(&writerLock);
+}
+
+// copies one record into the calling thread's ring, waiting for the writer while it is full
+void appendRecord(LogRecordHeader *header, const void *payload, size_t payloadSize) {
+    if (!atomic_load_explicit(&logRunning, memory_order_acquire)) return;
+    header->size = (uint16_t)((sizeof(LogRecordHeader) + payloadSize + 7) & ~(size_t)7);
+    LogRing *ring = threadRing;
+    if (ring == NULL && (threadRingless || (ring = threadRing = claimRing()) == NULL)) {
+        threadRingless = 1;
+        atomic_fetch_add_explicit(&logLostBytes, header->size, memory_order_relaxed);
+        return;
+    }
+    header->ring = ring->id;
+    header->timeNs = logNowNs();
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (used < LOG_RING_BYTES / 2 && used + header->size >= LOG_RING_BYTES / 2) wakeWriter();
+    while (head + header->size - atomic_load_explicit(&ring->tail, memory_order_acquire) > LOG_RING_BYTES) {
+        wakeWriter();
+        sched_yield();
+    }
+    char record[sizeof(LogRecordHeader) + MAX_LOG_TEXT + 8];
+    memset(record + sizeof(LogRecordHeader) + payloadSize, 0, header->size - sizeof(LogRecordHeader) - payloadSize);
+    memcpy(record, header, sizeof(LogRecordHeader));
+    memcpy(record + sizeof(LogRecordHeader), payload, payloadSize);
+    size_t at = head & (LOG_RING_BYTES - 1), first = LOG_RING_BYTES - at;
+    if (first >= header->size) {
+        memcpy(ring->bytes + at, record, header->size);
+    } else { // the file is a byte stream, a record may wrap around the ring
+        memcpy(ring->bytes + at, record, first);
+        memcpy(ring->bytes, record + first, header->size - first);
+    }
+    atomic_store_explicit(&ring->head, head + header->size, memory_order_release);
+    // pairs with the fence in logWriterThread, either the writer sees this head or we see it idle
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writerIdle, memory_order_relaxed) && atomic_exchange(&writerIdle, 0)) wakeWriter();
+}
+
+void logEvent(int event, int32_t a, int32_t b, int32_t c, int32_t d) {
+    LogRecordHeader header;
+    int32_t args[LOG_ARGS] = { a, b, c, d };
+    header.event = event;
+    appendRecord(&header, args, sizeof(args));
+}
+
+void logLine(const char *format, ...) {
+    char text[MAX_LOG_TEXT];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0) return;
+    if (length >= (int)sizeof(text)) length = sizeof(text) - 1;
+    LogRecordHeader header;
+    header.event = LOG_TEXT;
+    appendRecord(&header, text, length + 1);
+}
+
+// one pass over every ring, returns the bytes written. a ring holds at most two
+// segments, the part up to the end of its buffer and the part that wrapped
+long flushRings() {
+    struct iovec iov[2 * MAX_LOG_RINGS];
+    uint64_t heads[MAX_LOG_RINGS];
+    int count = atomic_load(&logRingCount), segments = 0;
+    long total = 0;
+    for (int i = 0; i < count; ++i) {
+        LogRing *ring = logRings[i];
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        heads[i] = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t pending = heads[i] - tail, at = tail & (LOG_RING_BYTES - 1);
+        if (pending == 0) continue;
+        size_t first = (pending < LOG_RING_BYTES - at) ? pending : LOG_RING_BYTES - at;
+        iov[segments].iov_base = ring->bytes + at;
+        iov[segments++].iov_len = first;
+        if (first < pending) {
+            iov[segments].iov_base = ring->bytes;
+            iov[segments++].iov_len = pending - first;
+        }
+        total += pending;
+    }
+    // writev may stop early, the rest goes out before any tail moves
+    for (int done = 0; done < segments; ) {
+        int batch = (segments - done > IOV_MAX) ? IOV_MAX : segments - done;
+        ssize_t written = writev(logFd, iov + done, batch);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            // the tails move anyway so no thread blocks on a full ring, the loss is counted
+            static int reported = 0; // only the writer gets here
+            if (!reported) perror("Failed to write log");
+            reported = 1;
+            uint64_t lost = 0;
+            for (int i = done; i < segments; ++i) {
+                lost += iov[i].iov_len;
+            }
+            atomic_fetch_add(&logLostBytes, lost);
+            break;
+        }
+        while (done < segments && (size_t)written >= iov[done].iov_len) {
+            written -= iov[done++].iov_len;
+        }
+        if (done < segments) {
+            iov[done].iov_base = (char *)iov[done].iov_base + written;
+            iov[done].iov_len -= written;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        LogRing *ring = logRings[i];
+        atomic_store_explicit(&ring->tail, heads[i], memory_order_release);
+        int retired = RING_RETIRED;
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) == heads[i]) {
+            atomic_compare_exchange_strong(&ring->state, &retired, RING_FREE);
+        }
+    }
+    return total;
+}
+
+// a pass every LOG_FLUSH_INTERVAL_NS while records come in, an untimed wait once every ring is empty
+void *logWriterThread(void *arg) {
+    while (1) {
+        int stopping = atomic_load(&logStopping);
+        if (flushRings() > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += LOG_FLUSH_INTERVAL_NS;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_mutex_lock(&writerLock);
+            if (!atomic_load(&logStopping)) pthread_cond_timedwait(&writerWake, &writerLock, &ts);
+            pthread_mutex_unlock(&writerLock);
+            continue;
+        }
+        if (stopping) break; // a pass after the stop request found nothing left
+        atomic_store(&writerIdle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (flushRings() > 0) { // a record came in before the flag was visible
+            atomic_store(&writerIdle, 0);
+            continue;
+        }
+        pthread_mutex_lock(&writerLock);
+        while (atomic_load(&writerIdle) && !atomic_load(&logStopping)) {
+            pthread_cond_wait(&writerWake, &writerLock);
+        }
+        pthread_mutex_unlock(&writerLock);
+        atomic_store(&writerIdle, 0);
+    }
+    return NULL;
+}
+
+int startLog(const char *path) {
+    logFd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (logFd == -1) return -1;
+    static int keyCreated = 0;
+    if (!keyCreated) {
+        pthread_key_create(&logRingKey, retireRing);
+        keyCreated = 1;
+    }
+    atomic_store(&logStopping, 0);
+    atomic_store(&writerIdle, 0);
+    atomic_store(&logLostBytes, 0);
+    atomic_store(&logRunning, 1);
+    if (pthread_create(&logWriter, NULL, logWriterThread, NULL) != 0) {
+        atomic_store(&logRunning, 0);
+        close(logFd);
+        logFd = -1;
+        return -1;
+    }
+    logEvent(LOG_OPEN, LOG_MAGIC, LOG_VERSION, (int32_t)getpid(), 0);
+    return 0;
+}
+
+// records appended after this are dropped
+void stopLog() {
+    if (!atomic_exchange(&logRunning, 0)) return;
+    atomic_store(&logStopping, 1);
+    wakeWriter();
+    pthread_join(logWriter, NULL);
+    close(logFd);
+    logFd = -1;
+    uint64_t lost = atomic_load(&logLostBytes);
+    if (lost > 0) fprintf(stderr, "Log lost %llu bytes of records\n", (unsigned long long)lost);
+}
+
+uint64_t logLost() {
+    return atomic_load(&logLostBytes);
+}
+
+int renderLogRecord(const LogRecordHeader *header, const void *payload, char *text, size_t size) {
+    const int32_t *args = (const int32_t *)payload;
+    switch (header->event) {
+    case LOG_OPEN:
+        return snprintf(text, size, "%s", "");
+    case LOG_TEXT:
+        return snprintf(text, size, "%s", (const char *)payload);
+    case LOG_ORDER_CREATED:
+        return snprintf(text, size, "Customer location: %d %d\nOrder %d created for location (%d, %d)\n", args[1], args[2], args[0], args[1], args[2]);
+    case LOG_COOK_PREPARING:
+        return snprintf(text, size, "Cook %d: Preparing order %d\n", args[0], args[1]);
+    case LOG_COOK_COOKING:
+        return snprintf(text, size, "Cook %d: Cooking order %d\n", args[0], args[1]);
+    case LOG_COOK_PLACED:
+        return snprintf(text, size, "Cook %d: Placed order %d in oven with aparatus %d\n", args[0], args[1], args[2]);
+    case LOG_OVEN_REMOVED:
+        return snprintf(text, size, "Oven: Removed order %d from oven with aparatus%d\n", args[0], args[1]);
+    case LOG_PICKED_UP:
+        return snprintf(text, size, "Delivery %d: Picked up order %d\n", args[0], args[1]);
+    case LOG_ROUTE:
+        return snprintf(text, size, "Delivery %d: Starting delivery with %d orders, route %.1f\n", args[0], args[1], args[2] / 10.0);
+    case LOG_DELIVERING:
+        return snprintf(text, size, "Delivery %d: Delivering order %d to (%d, %d)\n", args[0], args[1], args[2], args[3]);
+    case LOG_DELIVERED:
+        return snprintf(text, size, "Delivery %d: Delivered order %d\n", args[0], args[1]);
+    }
+    return snprintf(text, size, "unknown log event %d\n", header->event);
+}
@@ -0,0 +1,52 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_RING_BYTES (1 << 16) // per thread, a power of two
+#define MAX_LOG_RINGS 2048 // allocated as threads first log, rings of finished threads are reused
+#define LOG_FLUSH_INTERVAL_NS 1000000L // between writer passes while records come in, or until a ring is half full
+#define LOG_MAGIC 0x45444950 // "PIDE" on disk, first argument of every LOG_OPEN record
+#define LOG_VERSION 1
+
+// the text each event renders to is in renderLogRecord
+#define LOG_OPEN 0 // a server process opened the log, starts a session
+#define LOG_TEXT 1 // preformatted line, for the rare messages
+#define LOG_ORDER_CREATED 2 // orderId x y
+#define LOG_COOK_PREPARING 3 // cook orderId
+#define LOG_COOK_COOKING 4 // cook orderId
+#define LOG_COOK_PLACED 5 // cook orderId oven
+#define LOG_OVEN_REMOVED 6 // orderId oven
+#define LOG_PICKED_UP 7 // courier orderId
+#define LOG_ROUTE 8 // courier stops route*10
+#define LOG_DELIVERING 9 // courier orderId x y
+#define LOG_DELIVERED 10 // courier orderId
+#define LOG_EVENTS 11
+
+// every record starts with this header and is padded to 8 bytes. events carry
+// LOG_ARGS int32 arguments, LOG_TEXT carries the NUL terminated line
+typedef struct {
+    uint16_t size; // whole record, header included
+    uint16_t event;
+    uint32_t ring; // which thread wrote it
+    uint64_t timeNs; // CLOCK_MONOTONIC
+} LogRecordHeader;
+
+#define LOG_ARGS 4
+#define MAX_LOG_TEXT 240
+
+// each thread appends to its own single producer ring without locks or syscalls, a writer
+// thread moves whatever the rings hold to the file with one writev per pass. a thread only
+// waits when its ring is full, the writer stays LOG_RING_BYTES behind at most. with every
+// ring empty the writer sleeps until the next record
+int startLog(const char *path); // -1 when the file cannot be opened or the writer cannot start
+void stopLog(); // drains every ring, closes the file, reports the bytes lost
+uint64_t logLost(); // bytes of records dropped, by write errors or by threads past MAX_LOG_RINGS
+void logEvent(int event, int32_t a, int32_t b, int32_t c, int32_t d);
+void logLine(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// one record as the text lines the old logMessage wrote, returns their length
+int renderLogRecord(const LogRecordHeader *header, const void *payload, char *text, size_t size);
+
+#endif
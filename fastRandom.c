@@ -0,0 +1,78 @@
+#include <stdatomic.h>
+#include "fastRandom.h"
+
+typedef struct {
+    uint64_t s[4];
+    int seeded;
+} RandomState;
+
+__thread RandomState randomState;
+
+uint64_t baseSeed = 0x5eed;
+atomic_ulong nextStream = RANDOM_RESERVED_STREAMS;
+
+uint64_t rotateLeft(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+// splitmix64, spreads one 64 bit seed over the four state words
+uint64_t splitMix(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void setRandomSeed(uint64_t seed) {
+    baseSeed = seed;
+    atomic_store(&nextStream, RANDOM_RESERVED_STREAMS);
+}
+
+uint64_t randomSeed() {
+    return baseSeed;
+}
+
+void seedRandom(uint64_t stream) {
+    uint64_t x = baseSeed ^ splitMix(&stream);
+    for (int i = 0; i < 4; ++i) {
+        randomState.s[i] = splitMix(&x);
+    }
+    randomState.seeded = 1;
+}
+
+static inline uint64_t nextState(RandomState *state) {
+    uint64_t *s = state->s;
+    uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 45);
+    return result;
+}
+
+uint64_t nextRandom() {
+    if (!randomState.seeded) seedRandom(atomic_fetch_add(&nextStream, 1));
+    return nextState(&randomState);
+}
+
+// Lemire's multiply-shift on the top 32 bits, bias is at most bound / 2^32
+static inline int scaleBelow(uint64_t value, int bound) {
+    return (int)(((value >> 32) * (uint64_t)bound) >> 32);
+}
+
+int randomBelow(int bound) {
+    return scaleBelow(nextRandom(), bound);
+}
+
+// works on a local copy of the state so the loop stays in registers
+void fillRandomBelow(double *values, size_t count, int bound) {
+    if (!randomState.seeded) seedRandom(atomic_fetch_add(&nextStream, 1));
+    RandomState state = randomState;
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = scaleBelow(nextState(&state), bound);
+    }
+    randomState = state;
+}
@@ -0,0 +1,21 @@
+#ifndef FAST_RANDOM_H
+#define FAST_RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// per-thread xoshiro256** generator, a replacement for rand() which serializes every
+// caller on one glibc lock. a thread seeded with the same (seed, stream) pair always
+// draws the same sequence, so a run can be replayed by reusing the seed.
+// threads that never call seedRandom get stream numbers in the order they first draw,
+// counting from RANDOM_RESERVED_STREAMS so they never share a stream picked by a caller
+#define RANDOM_RESERVED_STREAMS 1024 // seedRandom streams below this are the caller's to hand out
+
+void setRandomSeed(uint64_t seed); // base seed for streams seeded afterwards
+uint64_t randomSeed();
+void seedRandom(uint64_t stream); // restarts the calling thread on its own stream
+uint64_t nextRandom();
+int randomBelow(int bound); // uniform in [0, bound)
+void fillRandomBelow(double *values, size_t count, int bound); // bulk randomBelow into doubles
+
+#endif
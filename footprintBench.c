@@ -0,0 +1,78 @@
+// footprintBench.c
+// memory for N in-flight orders: the old malloc'd Order with two BUFFER_SIZE strings
+// against the compact Order handed out by orderPool
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "orderPool.h"
+
+// Order as it was before the compact layout
+typedef struct LegacyOrder {
+    struct LegacyOrder *next;
+    int orderId;
+    int customerX, customerY;
+    int orderDistanceConstanst;
+    char customerLocation[BUFFER_SIZE];
+    char status[BUFFER_SIZE];
+} LegacyOrder;
+
+// resident set size in kB from /proc/self/status
+long residentKb() {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmRSS: %ld kB", &kb) == 1) break;
+    }
+    fclose(file);
+    return kb;
+}
+
+int main(int argc, char *argv[]) {
+    int count = (argc == 2) ? atoi(argv[1]) : 1000000;
+    if (count <= 0) {
+        printf("Wrong Argument, please enter proper arguments: [inFlightOrders(optional)]\n");
+        exit(1);
+    }
+
+    void **held = malloc(sizeof(void *) * count);
+    memset(held, 0, sizeof(void *) * count); // keep the pointer array out of both measurements
+    // compact first so it cannot reuse pages the legacy run freed
+    long before = residentKb();
+    for (int i = 0; i < count; ++i) {
+        Order *order = allocOrder();
+        order->orderId = i;
+        order->customerX = i % 100;
+        order->customerY = i % 77;
+        order->status = ORDER_RECEIVED;
+        held[i] = order;
+    }
+    long compactKb = residentKb() - before;
+    size_t poolBytes = orderPoolBytes();
+    for (int i = 0; i < count; ++i) {
+        releaseOrder(held[i]);
+    }
+    before = residentKb();
+    for (int i = 0; i < count; ++i) {
+        LegacyOrder *order = malloc(sizeof(LegacyOrder));
+        order->orderId = i;
+        order->customerX = i % 100;
+        order->customerY = i % 77;
+        order->customerLocation[0] = '\0';
+        strcpy(order->status, "Received");
+        held[i] = order;
+    }
+    long legacyKb = residentKb() - before;
+    for (int i = 0; i < count; ++i) {
+        free(held[i]);
+    }
+    free(held);
+
+    printf("%d orders in flight\n", count);
+    printf("%-22s %8s %14s %12s\n", "layout", "sizeof", "resident MB", "bytes/order");
+    printf("%-22s %8zu %14.1f %12.1f\n", "malloc, char[] fields", sizeof(LegacyOrder), legacyKb / 1024.0, legacyKb * 1024.0 / count);
+    printf("%-22s %8zu %14.1f %12.1f\n", "pool, compact", sizeof(Order), compactKb / 1024.0, compactKb * 1024.0 / count);
+    printf("pool slabs: %.1f MB\n", poolBytes / (1024.0 * 1024.0));
+    return 0;
+}
@@ -0,0 +1,207 @@
+// frontEndBench.c
+// floods the server with orders and reports orders/sec and latency, run it once against
+// each front end model of serverExe. window 0 sends one shot "x-y-total" orders over a new
+// connection each, otherwise every thread pipelines framed messages of batch orders over one connection
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <time.h>
+
+#define BUFFER_SIZE 2048
+#define REPLY_BUFFER_SIZE 65536
+
+typedef struct {
+    int id;
+    int orderCount;
+    int messageCount;
+    long *latencies; // nanoseconds, one per order or per batch message
+    pthread_t thread;
+} BenchWorker;
+
+char *serverIp;
+int serverPort;
+int totalOrders;
+int pipelineWindow;
+int batchSize;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int compareLong(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+int connectToServer() {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("Socket creation failed");
+        return -1;
+    }
+
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(serverPort);
+    inet_pton(AF_INET, serverIp, &server.sin_addr);
+
+    if (connect(sock, (struct sockaddr *)&server, sizeof(server)) == -1) {
+        perror("Connection to server failed");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// one order over a fresh connection, same as the old sendOrder in clientGenerator
+int sendOneShot(int x, int y) {
+    int sock = connectToServer();
+    if (sock == -1) return -1;
+
+    char message[BUFFER_SIZE];
+    snprintf(message, sizeof(message), "%d-%d-%d", x, y, totalOrders);
+    send(sock, message, strlen(message), 0);
+
+    char response[BUFFER_SIZE];
+    int bytesReceived = recv(sock, response, sizeof(response) - 1, 0);
+    close(sock);
+    return bytesReceived > 0 ? 0 : -1;
+}
+
+// keeps up to pipelineWindow framed messages in flight, latency is send-to-reply per sequence number
+void runPipelined(BenchWorker *worker) {
+    int sock = connectToServer();
+    if (sock == -1) {
+        worker->orderCount = 0;
+        return;
+    }
+    int messageCount = (worker->orderCount + batchSize - 1) / batchSize;
+    long *sentAt = malloc(sizeof(long) * messageCount);
+    char *replies = malloc(REPLY_BUFFER_SIZE);
+    char *message = malloc(BUFFER_SIZE + batchSize * 24);
+    int replyLen = 0;
+    int sent = 0, acked = 0, ordersSent = 0;
+    while (acked < messageCount) {
+        while (sent < messageCount && sent - acked < pipelineWindow) {
+            int count = worker->orderCount - ordersSent < batchSize ? worker->orderCount - ordersSent : batchSize;
+            int len;
+            if (batchSize == 1) {
+                len = sprintf(message, "O %d %d %d %d\n", sent, 100 + (worker->id * 7 + sent) % 50, 100 + (worker->id * 3 + sent) % 50, totalOrders);
+            } else {
+                len = sprintf(message, "B %d %d %d", sent, totalOrders, count);
+                for (int i = 0; i < count; ++i) {
+                    len += sprintf(message + len, " %d %d", 100 + (worker->id * 7 + ordersSent + i) % 50, 100 + (worker->id * 3 + i) % 50);
+                }
+                len += sprintf(message + len, "\n");
+            }
+            sentAt[sent] = nowNs();
+            if (send(sock, message, len, 0) != len) goto done;
+            ordersSent += count;
+            sent++;
+        }
+
+        int bytesReceived = recv(sock, replies + replyLen, REPLY_BUFFER_SIZE - 1 - replyLen, 0);
+        if (bytesReceived <= 0) break;
+        replyLen += bytesReceived;
+        replies[replyLen] = '\0';
+        long now = nowNs();
+        char *line = replies, *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            unsigned int seq;
+            if (sscanf(line, "R %u", &seq) == 1 && seq < (unsigned int)messageCount) {
+                worker->latencies[acked] = now - sentAt[seq];
+            }
+            acked++;
+            line = newline + 1;
+        }
+        replyLen = strlen(line);
+        memmove(replies, line, replyLen);
+    }
+done:
+    worker->orderCount = acked < messageCount ? acked * batchSize : worker->orderCount;
+    worker->messageCount = acked;
+    free(message);
+    free(replies);
+    free(sentAt);
+    close(sock);
+}
+
+void *benchThread(void *arg) {
+    BenchWorker *worker = (BenchWorker *)arg;
+    if (pipelineWindow > 0) {
+        runPipelined(worker);
+        return NULL;
+    }
+    for (int i = 0; i < worker->orderCount; ++i) {
+        // far away customers so couriers never sleep during the run
+        int x = 100 + (worker->id * 7 + i) % 50;
+        int y = 100 + (worker->id * 3 + i) % 50;
+        long start = nowNs();
+        if (sendOneShot(x, y) == -1) {
+            worker->orderCount = i;
+            break;
+        }
+        worker->latencies[i] = nowNs() - start;
+        worker->messageCount = i + 1;
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 5 || argc > 7) {
+        printf("Wrong Argument, please enter proper arguments: [ip] [portnumber] [threads] [orders] [window(optional, 0 = new connection per order)] [batch(optional)]\n");
+        exit(1);
+    }
+    serverIp = argv[1];
+    serverPort = atoi(argv[2]);
+    int threadCount = atoi(argv[3]);
+    totalOrders = atoi(argv[4]);
+    pipelineWindow = (argc >= 6) ? atoi(argv[5]) : 0;
+    batchSize = (argc == 7) ? atoi(argv[6]) : 1;
+    if (threadCount <= 0 || totalOrders <= 0 || batchSize <= 0 || (batchSize > 1 && pipelineWindow == 0)) {
+        printf("threads, orders and batch must be positive, batches need a window\n");
+        exit(1);
+    }
+
+    BenchWorker *workers = calloc(threadCount, sizeof(BenchWorker));
+    long start = nowNs();
+    for (int i = 0; i < threadCount; ++i) {
+        workers[i].id = i;
+        workers[i].orderCount = totalOrders / threadCount + (i < totalOrders % threadCount);
+        workers[i].latencies = malloc(sizeof(long) * (workers[i].orderCount + 1));
+        pthread_create(&workers[i].thread, NULL, benchThread, &workers[i]);
+    }
+
+    int completed = 0;
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        completed += workers[i].orderCount;
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+
+    long *all = malloc(sizeof(long) * (completed + 1));
+    int n = 0;
+    for (int i = 0; i < threadCount; ++i) {
+        memcpy(all + n, workers[i].latencies, sizeof(long) * workers[i].messageCount);
+        n += workers[i].messageCount;
+        free(workers[i].latencies);
+    }
+    qsort(all, n, sizeof(long), compareLong);
+
+    printf("orders: %d/%d in %.3f s\n", completed, totalOrders, elapsed);
+    printf("throughput: %.0f orders/sec\n", completed / elapsed);
+    if (n > 0) {
+        printf("%s latency us: p50 %.1f  p99 %.1f  max %.1f\n", pipelineWindow > 0 ? "send-to-reply" : "connect-to-reply",
+               all[n / 2] / 1e3, all[(int)(n * 0.99)] / 1e3, all[n - 1] / 1e3);
+    }
+
+    free(all);
+    free(workers);
+    return 0;
+}
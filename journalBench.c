@@ -0,0 +1,200 @@
+// journalBench.c
+// what durable orders cost. first the acknowledgement: T front end threads each journal an
+// order and wait until it is on disk, once with the group commit of orderJournal.c and once
+// with a write and fdatasync per order. then the restart: a journal of a million orders, most
+// of them delivered, is replayed the way the server does on startup and rewritten to the
+// ones still in flight, and the rewritten file is replayed again as the next start would
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "orderJournal.h"
+
+#define ACKS_PER_RUN 20000
+#define RESTART_ORDERS 1000000
+#define IN_FLIGHT_EVERY 100 // one order in a hundred is unfinished when the shop goes down
+#define BENCH_JOURNAL "journalBench.journal"
+
+typedef struct {
+    int id;
+    int orders;
+    pthread_t thread;
+} BenchThread;
+
+pthread_barrier_t startBarrier;
+pthread_mutex_t syncLock = PTHREAD_MUTEX_INITIALIZER;
+int syncFd;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void *groupThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    Order order;
+    Order *batch[1] = { &order };
+    memset(&order, 0, sizeof(order));
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->orders; ++i) {
+        order.orderId = bench->id * bench->orders + i + 1;
+        waitJournal(journalOrders(batch, 1));
+    }
+    return NULL;
+}
+
+// the record is the same, every order pays for its own sync
+void *syncThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = JOURNAL_CREATED;
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->orders; ++i) {
+        record.orderId = bench->id * bench->orders + i + 1;
+        pthread_mutex_lock(&syncLock);
+        if (write(syncFd, &record, sizeof(record)) != sizeof(record) || fdatasync(syncFd) == -1) {
+            perror("Failed to write bench journal");
+            exit(1);
+        }
+        pthread_mutex_unlock(&syncLock);
+    }
+    return NULL;
+}
+
+// returns acknowledged orders per second, and through *syncs the fdatasync calls it took
+double runAcks(int threadCount, int group, uint64_t *syncs) {
+    BenchThread *threads = calloc(threadCount, sizeof(BenchThread));
+    int orders = (group ? ACKS_PER_RUN : ACKS_PER_RUN / 10) / threadCount; // per order syncs are slow
+    remove(BENCH_JOURNAL);
+    uint64_t syncsBefore = 0;
+    if (group) {
+        if (openJournal(BENCH_JOURNAL) == -1) {
+            perror("Failed to open bench journal");
+            exit(1);
+        }
+        syncsBefore = journalSyncs();
+    } else {
+        syncFd = open(BENCH_JOURNAL, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (syncFd == -1) {
+            perror("Failed to open bench journal");
+            exit(1);
+        }
+    }
+    pthread_barrier_init(&startBarrier, NULL, threadCount + 1);
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].id = i;
+        threads[i].orders = orders;
+        pthread_create(&threads[i].thread, NULL, group ? groupThread : syncThread, &threads[i]);
+    }
+    long start = nowNs();
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    long elapsed = nowNs() - start;
+    if (group) {
+        *syncs = journalSyncs() - syncsBefore;
+        closeJournal();
+    } else {
+        *syncs = (uint64_t)orders * threadCount;
+        close(syncFd);
+    }
+    pthread_barrier_destroy(&startBarrier);
+    free(threads);
+    return orders * threadCount / (elapsed / 1e9);
+}
+
+long fileBytes(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return 0;
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file);
+    fclose(file);
+    return bytes;
+}
+
+// every order created, most of them baked, driven and delivered, in batches as the front ends would
+void writeHistory() {
+    remove(BENCH_JOURNAL);
+    if (openJournal(BENCH_JOURNAL) == -1) {
+        perror("Failed to open bench journal");
+        exit(1);
+    }
+    Order orders[64];
+    Order *batch[64];
+    memset(orders, 0, sizeof(orders));
+    for (int i = 0; i < 64; ++i) {
+        batch[i] = &orders[i];
+    }
+    for (int first = 1; first <= RESTART_ORDERS; first += 64) {
+        for (int i = 0; i < 64; ++i) {
+            orders[i].orderId = first + i;
+            orders[i].customerX = (int16_t)((first + i) % 1000);
+            orders[i].customerY = (int16_t)((first + i) % 777);
+            orders[i].menuItem = (first + i) % 4;
+        }
+        journalOrders(batch, 64);
+        for (int i = 0; i < 64; ++i) {
+            int id = first + i;
+            if (id % IN_FLIGHT_EVERY == 0) continue; // still waiting for a cook
+            journalStage(id, JOURNAL_BAKED);
+            if (id % IN_FLIGHT_EVERY == 1) continue; // waiting for a courier
+            journalStage(id, JOURNAL_DELIVERING);
+            journalStage(id, id % 50 == 2 ? JOURNAL_CANCELLED : JOURNAL_DELIVERED); // a late cancel changes nothing
+        }
+    }
+    closeJournal();
+}
+
+int main() {
+    int threadCounts[] = { 1, 4, 16, 64 };
+    printf("acknowledged orders per second, each one on disk before its reply\n");
+    printf("%-8s %14s %10s %14s %10s %9s\n", "threads", "group commit", "syncs", "sync per order", "syncs", "speedup");
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i) {
+        uint64_t groupSyncs, orderSyncs;
+        double group = runAcks(threadCounts[i], 1, &groupSyncs);
+        double perOrder = runAcks(threadCounts[i], 0, &orderSyncs);
+        printf("%-8d %14.0f %10llu %14.0f %10llu %8.1fx\n", threadCounts[i], group, (unsigned long long)groupSyncs,
+               perOrder, (unsigned long long)orderSyncs, group / perOrder);
+    }
+
+    long start = nowNs();
+    writeHistory();
+    printf("\n%d orders journalled in %.2f s, %ld bytes\n", RESTART_ORDERS, (nowNs() - start) / 1e9, fileBytes(BENCH_JOURNAL));
+
+    RecoveredOrder *recovered;
+    int maxOrderId;
+    start = nowNs();
+    int count = replayJournal(BENCH_JOURNAL, &recovered, &maxOrderId);
+    long replayNs = nowNs() - start;
+    if (count == -1) {
+        perror("Failed to replay bench journal");
+        exit(1);
+    }
+    int cooked = 0;
+    for (int i = 0; i < count; ++i) {
+        if (recovered[i].status == ORDER_COOKED) cooked++;
+    }
+    start = nowNs();
+    if (rewriteJournal(BENCH_JOURNAL, recovered, count, maxOrderId) == -1) {
+        perror("Failed to rewrite bench journal");
+        exit(1);
+    }
+    long rewriteNs = nowNs() - start;
+    printf("replay   %8.1f ms, %d in flight (%d for the kitchen, %d for the couriers), highest id %d\n",
+           replayNs / 1e6, count, count - cooked, cooked, maxOrderId);
+    printf("rewrite  %8.1f ms, %ld bytes\n", rewriteNs / 1e6, fileBytes(BENCH_JOURNAL));
+    free(recovered);
+
+    start = nowNs();
+    count = replayJournal(BENCH_JOURNAL, &recovered, &maxOrderId);
+    printf("replay of the rewritten journal %.1f ms, %d in flight, highest id %d\n", (nowNs() - start) / 1e6, count, maxOrderId);
+    free(recovered);
+    remove(BENCH_JOURNAL);
+    return 0;
+}
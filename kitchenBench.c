@@ -0,0 +1,129 @@
+// kitchenBench.c
+// orders/s through prep and oven with one thread per oven slot. serial is the old cook that
+// prepares, bakes (a second pseudo-inverse) and removes before taking the next order,
+// pipelined prepares and leaves the bake to the oven timer thread
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "oven.h"
+#include "complexMatrix.h"
+#include "fastRandom.h"
+
+typedef struct {
+    int id;
+    ComplexMatrix recipe, inverse;
+    MatrixWorkspace workspace;
+    pthread_t thread;
+} BenchCook;
+
+OvenManager ovens;
+Order *orders;
+int orderCount, rows = 30, cols = 40;
+atomic_int nextOrder;
+atomic_int bakedOrders;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void prepare(BenchCook *cook) {
+    for (int i = 0; i < rows; ++i) {
+        fillRandomBelow(cook->recipe.re + (size_t)i * cook->recipe.stride, cols, 10);
+        fillRandomBelow(cook->recipe.im + (size_t)i * cook->recipe.stride, cols, 10);
+    }
+    pseudoInverse(&cook->recipe, &cook->inverse, &cook->workspace);
+}
+
+void *serialCook(void *arg) {
+    BenchCook *cook = (BenchCook *)arg;
+    seedRandom(cook->id);
+    for (int next; (next = atomic_fetch_add(&nextOrder, 1)) < orderCount; ) {
+        prepare(cook);
+        int slot = placeInOven(&ovens, &orders[next]);
+        prepare(cook); // baking used the cook's time
+        removeFromOven(&ovens, slot);
+        atomic_fetch_add(&bakedOrders, 1);
+    }
+    return NULL;
+}
+
+void *pipelinedCook(void *arg) {
+    BenchCook *cook = (BenchCook *)arg;
+    seedRandom(cook->id);
+    for (int next; (next = atomic_fetch_add(&nextOrder, 1)) < orderCount; ) {
+        long start = nowNs();
+        prepare(cook);
+        bakeInOven(&ovens, &orders[next], nowNs() - start);
+    }
+    return NULL;
+}
+
+void countBaked(Order *order, int slot, void *ctx) {
+    atomic_fetch_add(&bakedOrders, 1);
+}
+
+// returns orders per second
+double runKitchen(BenchCook *cooks, int cookCount, void *(*body)(void *)) {
+    atomic_store(&nextOrder, 0);
+    atomic_store(&bakedOrders, 0);
+    initOvenManager(&ovens);
+    if (body == pipelinedCook) startOvenTimer(&ovens, countBaked, NULL);
+    long start = nowNs();
+    for (int i = 0; i < cookCount; ++i) {
+        pthread_create(&cooks[i].thread, NULL, body, &cooks[i]);
+    }
+    for (int i = 0; i < cookCount; ++i) {
+        pthread_join(cooks[i].thread, NULL);
+    }
+    while (atomic_load(&bakedOrders) < orderCount) {
+        usleep(1000);
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    if (body == pipelinedCook) stopOvenTimer(&ovens);
+    destroyOvenManager(&ovens);
+    return orderCount / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    int cookCount = OVEN_SLOTS;
+    orderCount = (argc >= 2) ? atoi(argv[1]) : 2000;
+    if (argc == 4) {
+        rows = atoi(argv[2]);
+        cols = atoi(argv[3]);
+    }
+    if (orderCount <= 0 || rows <= 0 || cols <= 0 || argc == 3 || argc > 4) {
+        printf("Wrong Argument, please enter proper arguments: [orders(optional)] [rows cols(optional)]\n");
+        exit(1);
+    }
+    setRandomSeed(1);
+    orders = calloc(orderCount, sizeof(Order));
+    BenchCook *cooks = calloc(cookCount, sizeof(BenchCook));
+    for (int i = 0; i < cookCount; ++i) {
+        cooks[i].id = i;
+        initComplexMatrix(&cooks[i].recipe, rows, cols);
+        initComplexMatrix(&cooks[i].inverse, cols, rows);
+        initMatrixWorkspace(&cooks[i].workspace);
+    }
+
+    double serial = runKitchen(cooks, cookCount, serialCook);
+    double pipelined = runKitchen(cooks, cookCount, pipelinedCook);
+    printf("%d orders, %dx%d recipe, %d cooks on %d oven slots\n", orderCount, rows, cols, cookCount, OVEN_SLOTS);
+    printf("%-12s %12s\n", "kitchen", "orders/s");
+    printf("%-12s %12.1f\n", "serial", serial);
+    printf("%-12s %12.1f\n", "pipelined", pipelined);
+    printf("speedup %.2fx\n", pipelined / serial);
+
+    for (int i = 0; i < cookCount; ++i) {
+        freeComplexMatrix(&cooks[i].recipe);
+        freeComplexMatrix(&cooks[i].inverse);
+        freeMatrixWorkspace(&cooks[i].workspace);
+    }
+    free(cooks);
+    free(orders);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "latencyHistogram.h"
+
+StageLatencies *latencySets[MAX_LATENCY_THREADS];
+int latencySetUsed[MAX_LATENCY_THREADS];
+int latencySetCount = 0;
+StageLatencies sharedLatencies; // finished threads and threads past MAX_LATENCY_THREADS, under latencyLock
+pthread_mutex_t latencyLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t latencyKey;
+pthread_once_t latencyKeyOnce = PTHREAD_ONCE_INIT;
+__thread StageLatencies *threadLatencies;
+__thread int threadLatencySlot = -1;
+
+int bucketOf(uint32_t us) {
+    if (us < 2 * HISTOGRAM_SUB_BUCKETS) return us;
+    int exponent = 31 - __builtin_clz(us); // 6 and up
+    int shift = exponent - 5;
+    return 2 * HISTOGRAM_SUB_BUCKETS + (exponent - 6) * HISTOGRAM_SUB_BUCKETS + (int)(us >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+uint32_t bucketTop(int bucket) {
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) return bucket;
+    int exponent = (bucket - 2 * HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + 6;
+    uint64_t top = (bucket - 2 * HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return (uint32_t)(((top + 1) << (exponent - 5)) - 1);
+}
+
+// single writer, readers on other threads see each count whole
+void recordLatency(LatencyHistogram *histogram, uint32_t us) {
+    uint64_t *count = &histogram->counts[bucketOf(us)];
+    __atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+uint64_t histogramCount(const LatencyHistogram *histogram) {
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        total += histogram->counts[i];
+    }
+    return total;
+}
+
+uint32_t histogramPercentile(const LatencyHistogram *histogram, double percentile) {
+    uint64_t total = histogramCount(histogram);
+    if (total == 0) return 0;
+    uint64_t wanted = (uint64_t)(percentile / 100.0 * total + 0.5), seen = 0;
+    if (wanted == 0) wanted = 1;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= wanted) return bucketTop(i);
+    }
+    return bucketTop(HISTOGRAM_BUCKETS - 1);
+}
+
+const char *stageName(int stage) {
+    const char *names[ORDER_STAGES] = { "queue", "prepare", "oven wait", "bake", "dispatch", "bag wait", "travel", "total" };
+    return (stage >= 0 && stage < ORDER_STAGES) ? names[stage] : "unknown";
+}
+
+void addLatencies(StageLatencies *into, const StageLatencies *from) {
+    for (int s = 0; s < ORDER_STAGES; ++s) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            into->stages[s].counts[i] += __atomic_load_n(&from->stages[s].counts[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// a finished thread's counts move to the shared set and its slot is reused
+void retireLatencies(void *arg) {
+    int slot = (int)(intptr_t)arg - 1;
+    pthread_mutex_lock(&latencyLock);
+    addLatencies(&sharedLatencies, latencySets[slot]);
+    memset(latencySets[slot], 0, sizeof(StageLatencies));
+    latencySetUsed[slot] = 0;
+    pthread_mutex_unlock(&latencyLock);
+}
+
+void createLatencyKey() {
+    pthread_key_create(&latencyKey, retireLatencies);
+}
+
+int claimLatencySet() {
+    pthread_once(&latencyKeyOnce, createLatencyKey);
+    pthread_mutex_lock(&latencyLock);
+    int slot = -1;
+    for (int i = 0; i < latencySetCount && slot == -1; ++i) {
+        if (!latencySetUsed[i]) slot = i;
+    }
+    if (slot == -1 && latencySetCount < MAX_LATENCY_THREADS) {
+        StageLatencies *set = (StageLatencies *)calloc(1, sizeof(StageLatencies));
+        if (set != NULL) {
+            slot = latencySetCount++;
+            latencySets[slot] = set;
+        }
+    }
+    if (slot != -1) latencySetUsed[slot] = 1;
+    pthread_mutex_unlock(&latencyLock);
+    if (slot != -1) {
+        threadLatencies = latencySets[slot];
+        pthread_setspecific(latencyKey, (void *)(intptr_t)(slot + 1));
+    }
+    return slot;
+}
+
+void orderStages(const Order *order, uint32_t *stages) {
+    const uint32_t *stamps = order->stamps;
+    for (int s = 0; s < STAGE_TOTAL; ++s) {
+        stages[s] = stamps[s + 1] - stamps[s]; // unsigned, right across a clock wrap
+    }
+    stages[STAGE_TOTAL] = stamps[STAMP_DELIVERED] - stamps[STAMP_RECEIVED];
+}
+
+void recordOrderStages(const Order *order) {
+    uint32_t stages[ORDER_STAGES];
+    orderStages(order, stages);
+    if (threadLatencySlot == -1) threadLatencySlot = claimLatencySet();
+    if (threadLatencySlot == -1) { // more threads than sets
+        pthread_mutex_lock(&latencyLock);
+        for (int s = 0; s < ORDER_STAGES; ++s) {
+            recordLatency(&sharedLatencies.stages[s], stages[s]);
+        }
+        pthread_mutex_unlock(&latencyLock);
+        return;
+    }
+    for (int s = 0; s < ORDER_STAGES; ++s) {
+        recordLatency(&threadLatencies->stages[s], stages[s]);
+    }
+}
+
+void recordSharedOrderStages(StageLatencies *latencies, const Order *order) {
+    uint32_t stages[ORDER_STAGES];
+    orderStages(order, stages);
+    for (int s = 0; s < ORDER_STAGES; ++s) {
+        __atomic_fetch_add(&latencies->stages[s].counts[bucketOf(stages[s])], 1, __ATOMIC_RELAXED);
+    }
+}
+
+void collectStageLatencies(StageLatencies *merged) {
+    memset(merged, 0, sizeof(StageLatencies));
+    pthread_mutex_lock(&latencyLock);
+    addLatencies(merged, &sharedLatencies);
+    for (int i = 0; i < latencySetCount; ++i) {
+        if (latencySetUsed[i]) addLatencies(merged, latencySets[i]);
+    }
+    pthread_mutex_unlock(&latencyLock);
+}
+
+// counts only grow, so a later collection minus an earlier one is what happened in between
+void subtractStageLatencies(StageLatencies *latencies, const StageLatencies *since) {
+    for (int s = 0; s < ORDER_STAGES; ++s) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            latencies->stages[s].counts[i] -= since->stages[s].counts[i];
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include "order.h"
+
+// log-linear buckets in the style of HdrHistogram: exact below 64us, above that every power
+// of two is split into 32 buckets, so a reported value is within 1/32 of the real one
+#define HISTOGRAM_SUB_BUCKETS 32
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_SUB_BUCKETS + 26 * HISTOGRAM_SUB_BUCKETS) // up to 2^32 us
+#define MAX_LATENCY_THREADS 1024 // threads past this record into a shared set under a lock
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+// queue waits and service times between consecutive stamps, plus the whole trip
+#define STAGE_QUEUE 0 // received -> preparing
+#define STAGE_PREPARE 1 // preparing -> cooking
+#define STAGE_OVEN_WAIT 2 // cooking -> placed
+#define STAGE_BAKE 3 // placed -> removed
+#define STAGE_DISPATCH 4 // removed -> picked up
+#define STAGE_BAG_WAIT 5 // picked up -> delivering, earlier stops of the route
+#define STAGE_TRAVEL 6 // delivering -> delivered
+#define STAGE_TOTAL 7 // received -> delivered
+#define ORDER_STAGES 8
+
+typedef struct {
+    LatencyHistogram stages[ORDER_STAGES];
+} StageLatencies;
+
+void recordLatency(LatencyHistogram *histogram, uint32_t us); // only by the thread that owns it
+uint64_t histogramCount(const LatencyHistogram *histogram);
+uint32_t histogramPercentile(const LatencyHistogram *histogram, double percentile); // highest value of the bucket
+const char *stageName(int stage);
+
+// every thread fills its own StageLatencies without locks, readers add them up
+void recordOrderStages(const Order *order); // at delivery, when every stamp is set
+void recordSharedOrderStages(StageLatencies *latencies, const Order *order); // a set several threads add to
+void collectStageLatencies(StageLatencies *merged);
+void subtractStageLatencies(StageLatencies *latencies, const StageLatencies *since);
+
+#endif
@@ -0,0 +1,118 @@
+// logBench.c
+// cost of one cook log line to the calling thread: the old logMessage path (format into the
+// shared logText under logMutex, fprintf and fflush under the log lock) against logEvent
+// into the thread's ring. the ring time includes stopLog, so every record is on disk
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "eventLog.h"
+
+#define LINES_PER_RUN 400000
+#define BENCH_LOG "logBench.log"
+
+typedef struct {
+    int id;
+    int lines;
+    pthread_t thread;
+} BenchThread;
+
+pthread_barrier_t startBarrier;
+pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+FILE *legacyFile;
+char logText[1024];
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void legacyLogMessage(const char *message) {
+    pthread_mutex_lock(&logLock);
+    fprintf(legacyFile, "%s", message);
+    fflush(legacyFile);
+    logText[0] = '\0';
+    pthread_mutex_unlock(&logLock);
+}
+
+void *legacyThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->lines; ++i) {
+        pthread_mutex_lock(&logMutex);
+        snprintf(logText, sizeof(logText), "Cook %d: Preparing order %d\n", bench->id, i);
+        legacyLogMessage(logText);
+        pthread_mutex_unlock(&logMutex);
+    }
+    return NULL;
+}
+
+void *ringThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->lines; ++i) {
+        logEvent(LOG_COOK_PREPARING, bench->id, i, 0, 0);
+    }
+    return NULL;
+}
+
+// returns ns per line, wall time over all threads
+double runBench(int threadCount, int ring) {
+    BenchThread *threads = calloc(threadCount, sizeof(BenchThread));
+    remove(BENCH_LOG);
+    if (ring) {
+        if (startLog(BENCH_LOG) == -1) {
+            perror("Failed to open bench log");
+            exit(1);
+        }
+    } else {
+        legacyFile = fopen(BENCH_LOG, "a");
+        if (legacyFile == NULL) {
+            perror("Failed to open bench log");
+            exit(1);
+        }
+    }
+    pthread_barrier_init(&startBarrier, NULL, threadCount + 1);
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].id = i;
+        threads[i].lines = LINES_PER_RUN / threadCount;
+        pthread_create(&threads[i].thread, NULL, ring ? ringThread : legacyThread, &threads[i]);
+    }
+    long start = nowNs();
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    if (ring) stopLog();
+    else fclose(legacyFile);
+    long elapsed = nowNs() - start;
+    pthread_barrier_destroy(&startBarrier);
+    free(threads);
+    return (double)elapsed / (LINES_PER_RUN / threadCount * threadCount);
+}
+
+long fileBytes(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return 0;
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file);
+    fclose(file);
+    return bytes;
+}
+
+int main() {
+    int threadCounts[] = { 1, 2, 4, 8, 16 };
+    printf("%d cook lines per run, ns per line\n", LINES_PER_RUN);
+    printf("%-8s %12s %12s %9s %14s %14s\n", "threads", "logMessage", "logEvent", "speedup", "text bytes", "binary bytes");
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i) {
+        double legacy = runBench(threadCounts[i], 0);
+        long textBytes = fileBytes(BENCH_LOG);
+        double ring = runBench(threadCounts[i], 1);
+        long binaryBytes = fileBytes(BENCH_LOG);
+        printf("%-8d %12.1f %12.1f %8.1fx %14ld %14ld\n", threadCounts[i], legacy, ring, legacy / ring, textBytes, binaryBytes);
+    }
+    remove(BENCH_LOG);
+    return 0;
+}
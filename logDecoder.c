@@ -0,0 +1,94 @@
+// logDecoder.c
+// renders the binary server.log as the text lines the server used to write.
+// each thread logs to its own ring, so records are put back in time order per session.
+// -t prefixes every line with the seconds since its session opened
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eventLog.h"
+
+typedef struct {
+    const LogRecordHeader *header;
+    long position; // keeps records with the same timestamp in file order
+} DecodedRecord;
+
+int compareRecords(const void *a, const void *b) {
+    const DecodedRecord *x = (const DecodedRecord *)a, *y = (const DecodedRecord *)b;
+    if (x->header->timeNs != y->header->timeNs) return x->header->timeNs < y->header->timeNs ? -1 : 1;
+    return (x->position > y->position) - (x->position < y->position);
+}
+
+void printSession(DecodedRecord *records, int count, int withTime) {
+    char text[BUFSIZ];
+    qsort(records, count, sizeof(DecodedRecord), compareRecords);
+    uint64_t opened = records[0].header->timeNs; // LOG_OPEN sorts first, nothing logs before it
+    for (int i = 0; i < count; ++i) {
+        if (records[i].header->event == LOG_OPEN) continue;
+        renderLogRecord(records[i].header, records[i].header + 1, text, sizeof(text));
+        if (!withTime) {
+            fputs(text, stdout);
+            continue;
+        }
+        double seconds = (records[i].header->timeNs - opened) / 1e9;
+        for (char *line = strtok(text, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+            printf("%12.6f %s\n", seconds, line);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int withTime = (argc >= 2 && strcmp(argv[1], "-t") == 0);
+    if (argc > 2 + withTime) {
+        printf("Wrong Argument, please enter proper arguments: [-t(optional)] [logFile(optional, server.log)]\n");
+        exit(1);
+    }
+    const char *path = (argc == 2 + withTime) ? argv[1 + withTime] : "server.log";
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror("Failed to open log file");
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *bytes = malloc(length > 0 ? length : 1);
+    DecodedRecord *records = malloc(sizeof(DecodedRecord) * (length / sizeof(LogRecordHeader) + 1));
+    if (bytes == NULL || records == NULL) {
+        perror("Failed to allocate log buffer");
+        exit(1);
+    }
+    if (fread(bytes, 1, length, file) != (size_t)length) {
+        perror("Failed to read log file");
+        exit(1);
+    }
+    fclose(file);
+
+    int count = 0;
+    long at = 0;
+    while (at + (long)sizeof(LogRecordHeader) <= length) {
+        const LogRecordHeader *header = (const LogRecordHeader *)(bytes + at);
+        if (header->size < sizeof(LogRecordHeader) || header->size % 8 != 0 || at + header->size > length || header->event >= LOG_EVENTS) {
+            fprintf(stderr, "%s: damaged record at byte %ld, stopping\n", path, at);
+            break;
+        }
+        if (header->event == LOG_OPEN) {
+            const int32_t *args = (const int32_t *)(header + 1);
+            if (args[0] != LOG_MAGIC || args[1] != LOG_VERSION) {
+                fprintf(stderr, "%s: unknown log version at byte %ld\n", path, at);
+                break;
+            }
+            if (count > 0) printSession(records, count, withTime);
+            count = 0;
+        } else if (count == 0) {
+            fprintf(stderr, "%s: not a binary server log\n", path);
+            break;
+        }
+        records[count].header = header;
+        records[count++].position = at;
+        at += header->size;
+    }
+    if (count > 0) printSession(records, count, withTime);
+    free(records);
+    free(bytes);
+    return 0;
+}
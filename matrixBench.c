@@ -0,0 +1,96 @@
+// matrixBench.c
+// pseudoInverse GFLOP/s per matrix size for every kernel, with the Moore-Penrose residual
+// max|A X A - A| / max|A| as a correctness check. the optional argument sizes the matrix pool
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "complexMatrix.h"
+#include "fastRandom.h"
+
+#define MIN_BENCH_SECONDS 0.5
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void fillRandom(ComplexMatrix *m) {
+    for (int i = 0; i < m->rows; ++i) {
+        for (int j = 0; j < m->cols; ++j) {
+            Complex value = { randomBelow(10), randomBelow(10) };
+            matrixSet(m, i, j, value);
+        }
+    }
+}
+
+double residual(const ComplexMatrix *a, const ComplexMatrix *x) {
+    ComplexMatrix ax, axa;
+    initComplexMatrix(&ax, a->rows, a->rows);
+    initComplexMatrix(&axa, a->rows, a->cols);
+    complexMultiply(a, x, &ax);
+    complexMultiply(&ax, a, &axa);
+    double worst = 0.0, largest = 0.0;
+    for (int i = 0; i < a->rows; ++i) {
+        for (int j = 0; j < a->cols; ++j) {
+            Complex got = matrixGet(&axa, i, j), want = matrixGet(a, i, j);
+            worst = fmax(worst, hypot(got.real - want.real, got.imag - want.imag));
+            largest = fmax(largest, hypot(want.real, want.imag));
+        }
+    }
+    freeComplexMatrix(&ax);
+    freeComplexMatrix(&axa);
+    return worst / largest;
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[][2] = { { 30, 40 }, { 64, 80 }, { 128, 160 }, { 256, 320 }, { 512, 640 }, { 640, 512 } };
+    MatrixKernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+    int poolThreads = (argc == 2) ? atoi(argv[1]) : 0;
+    setRandomSeed(1);
+    if (poolThreads > 0 && startMatrixPool(poolThreads) == -1) {
+        printf("could not start %d matrix threads\n", poolThreads);
+        exit(1);
+    }
+
+    MatrixWorkspace workspace;
+    if (initMatrixWorkspace(&workspace) == -1) {
+        perror("Failed to allocate matrix workspace");
+        exit(1);
+    }
+    printf("matrix pool: %d helper threads\n", matrixPoolSize());
+    printf("%-10s %-8s %10s %10s %12s\n", "size", "kernel", "ms/call", "GFLOP/s", "residual");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int rows = sizes[s][0], cols = sizes[s][1];
+        ComplexMatrix a, x;
+        initComplexMatrix(&a, rows, cols);
+        initComplexMatrix(&x, cols, rows);
+        fillRandom(&a);
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            if (setMatrixKernel(kernels[k]) == -1) continue;
+            int calls = 0;
+            double start = nowSeconds(), elapsed = 0.0;
+            do {
+                if (pseudoInverse(&a, &x, &workspace) == -1) {
+                    printf("%dx%d is rank deficient\n", rows, cols);
+                    break;
+                }
+                calls++;
+                elapsed = nowSeconds() - start;
+            } while (elapsed < MIN_BENCH_SECONDS);
+            if (calls == 0) continue;
+
+            char label[32];
+            snprintf(label, sizeof(label), "%dx%d", rows, cols);
+            printf("%-10s %-8s %10.3f %10.2f %12.2e\n", label, matrixKernelName(), elapsed * 1e3 / calls,
+                   pseudoInverseFlops(rows, cols) * calls / elapsed / 1e9, residual(&a, &x));
+        }
+        freeComplexMatrix(&a);
+        freeComplexMatrix(&x);
+    }
+    freeMatrixWorkspace(&workspace);
+    stopMatrixPool();
+    return 0;
+}
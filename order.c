@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <time.h>
+#include "order.h"
+
+const char *orderStatusName(int status) {
+    switch (status) {
+    case ORDER_RECEIVED: return "Received";
+    case ORDER_PREPARING: return "Preparing";
+    case ORDER_COOKING: return "Cooking";
+    case ORDER_COOKED: return "Cooked";
+    case ORDER_DELIVERING: return "Delivering";
+    case ORDER_DELIVERED: return "Delivered";
+    case ORDER_CANCELLED: return "Cancelled";
+    default: return "Unknown";
+    }
+}
+
+const char *formatLocation(const Order *order, char *buffer, size_t size) {
+    snprintf(buffer, size, "(%d, %d)", order->customerX, order->customerY);
+    return buffer;
+}
+
+// status changes that can race with a cancel go through here
+int advanceOrderStatus(Order *order, OrderStatus from, OrderStatus to) {
+    uint8_t expected = from;
+    return __atomic_compare_exchange_n(&order->status, &expected, (uint8_t)to, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// an order can be cancelled until a courier starts driving to it. the worker holding it
+// notices at its next stage boundary, where advanceOrderStatus fails
+int cancelOrderStatus(Order *order) {
+    uint8_t status = __atomic_load_n(&order->status, __ATOMIC_ACQUIRE);
+    while (status <= ORDER_COOKED) {
+        if (__atomic_compare_exchange_n(&order->status, &status, (uint8_t)ORDER_CANCELLED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+    }
+    return status;
+}
+
+int readOrderStatus(const Order *order) {
+    return __atomic_load_n(&order->status, __ATOMIC_ACQUIRE);
+}
+
+// CLOCK_MONOTONIC in microseconds, cut to 32 bits so every stamp fits in the order's cache line
+uint32_t orderClockUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void stampOrder(Order *order, int stamp) {
+    order->stamps[stamp] = orderClockUs();
+}
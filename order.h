@@ -0,0 +1,53 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUFFER_SIZE 1024
+#define MAX_CUSTOMER_DISTANCE 32767 // customer coordinates are 16 bit
+
+typedef enum {
+    ORDER_RECEIVED,
+    ORDER_PREPARING,
+    ORDER_COOKING,
+    ORDER_COOKED,
+    ORDER_DELIVERING,
+    ORDER_DELIVERED,
+    ORDER_CANCELLED
+} OrderStatus;
+
+// moments an order passes through, the stage between two of them is timed
+#define STAMP_RECEIVED 0
+#define STAMP_PREPARING 1
+#define STAMP_COOKING 2
+#define STAMP_PLACED 3 // in an oven slot
+#define STAMP_REMOVED 4 // out of the oven
+#define STAMP_PICKED_UP 5
+#define STAMP_DELIVERING 6
+#define STAMP_DELIVERED 7
+#define ORDER_STAMPS 8
+
+// 64 bytes, one cache line. the location text is only built by formatLocation when a log line needs it
+typedef struct Order {
+    struct Order *next;
+    int32_t orderId;
+    int16_t customerX, customerY; // units from the shop, the server refuses farther customers
+    uint32_t dueUs; // order clock, the latest it should leave the shop, queues serve the earliest first
+    uint8_t status; // OrderStatus
+    uint8_t menuItem; // index into the server menu, picks the recipe matrix size
+    uint16_t client; // connection that placed it, keeps a client's orders on the same workers
+    int32_t spatialSlot; // position in its SpatialIndex cell while cooked and waiting
+    int32_t heapSlot; // position in the DeadlineHeap holding it, a cook's or the Dispatcher's
+    uint32_t stamps[ORDER_STAMPS]; // microseconds on a clock that wraps every 71 minutes, differences stay right
+} Order;
+
+const char *orderStatusName(int status);
+const char *formatLocation(const Order *order, char *buffer, size_t size);
+int advanceOrderStatus(Order *order, OrderStatus from, OrderStatus to); // 0 if status was no longer from
+int cancelOrderStatus(Order *order); // status it replaced, or the current one if already on its way
+int readOrderStatus(const Order *order);
+uint32_t orderClockUs();
+void stampOrder(Order *order, int stamp);
+
+#endif
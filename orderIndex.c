@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "orderIndex.h"
+
+IndexShard *shardOf(OrderIndex *index, int orderId) {
+    return &index->shards[orderId & (ORDER_INDEX_SHARDS - 1)];
+}
+
+// ids in one shard step by ORDER_INDEX_SHARDS, so the live ones land in neighbouring slots
+size_t homeSlot(IndexShard *shard, int orderId) {
+    return ((unsigned int)orderId / ORDER_INDEX_SHARDS) & shard->mask;
+}
+
+FinishedSlot *finishedSlot(IndexShard *shard, int orderId) {
+    return &shard->finished[((unsigned int)orderId / ORDER_INDEX_SHARDS) & (ORDER_INDEX_FINISHED - 1)];
+}
+
+void initOrderIndex(OrderIndex *index) {
+    atomic_init(&index->nextOrderId, 1);
+    for (int i = 0; i < ORDER_INDEX_SHARDS; ++i) {
+        IndexShard *shard = &index->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->slots = (IndexSlot *)calloc(ORDER_INDEX_MIN_SLOTS, sizeof(IndexSlot));
+        if (shard->slots == NULL) {
+            perror("Failed to allocate order index");
+            exit(1);
+        }
+        shard->mask = ORDER_INDEX_MIN_SLOTS - 1;
+        shard->count = 0;
+        memset(shard->finished, 0, sizeof(shard->finished));
+    }
+}
+
+int reserveOrderIds(OrderIndex *index, int count) {
+    return atomic_fetch_add(&index->nextOrderId, count);
+}
+
+void insertSlot(IndexShard *shard, int orderId, Order *order) {
+    size_t i = homeSlot(shard, orderId);
+    while (shard->slots[i].orderId != 0) {
+        i = (i + 1) & shard->mask;
+    }
+    shard->slots[i].orderId = orderId;
+    shard->slots[i].order = order;
+}
+
+// doubles the table, called with the shard lock held
+int growShard(IndexShard *shard) {
+    IndexSlot *old = shard->slots;
+    size_t oldSize = shard->mask + 1;
+    IndexSlot *slots = (IndexSlot *)calloc(oldSize * 2, sizeof(IndexSlot));
+    if (slots == NULL) return -1;
+    shard->slots = slots;
+    shard->mask = oldSize * 2 - 1;
+    for (size_t i = 0; i < oldSize; ++i) {
+        if (old[i].orderId != 0) insertSlot(shard, old[i].orderId, old[i].order);
+    }
+    free(old);
+    return 0;
+}
+
+// slot holding orderId, or -1. shard lock held
+long findSlot(IndexShard *shard, int orderId) {
+    size_t i = homeSlot(shard, orderId);
+    while (shard->slots[i].orderId != 0) {
+        if (shard->slots[i].orderId == orderId) return i;
+        i = (i + 1) & shard->mask;
+    }
+    return -1;
+}
+
+int indexOrder(OrderIndex *index, Order *order) {
+    IndexShard *shard = shardOf(index, order->orderId);
+    pthread_mutex_lock(&shard->lock);
+    if ((shard->count + 1) * 2 > shard->mask + 1 && growShard(shard) == -1) { // keep load under 1/2
+        pthread_mutex_unlock(&shard->lock);
+        return -1;
+    }
+    insertSlot(shard, order->orderId, order);
+    shard->count++;
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
+}
+
+void unindexOrder(OrderIndex *index, int orderId) {
+    IndexShard *shard = shardOf(index, orderId);
+    pthread_mutex_lock(&shard->lock);
+    long hole = findSlot(shard, orderId);
+    if (hole != -1) {
+        // a delivered or cancelled order stays answerable for a while after it is released
+        int status = readOrderStatus(shard->slots[hole].order);
+        if (status == ORDER_DELIVERED || status == ORDER_CANCELLED) {
+            FinishedSlot *finished = finishedSlot(shard, orderId);
+            finished->orderId = orderId;
+            finished->status = (uint8_t)status;
+        }
+        // move back every entry of the run that would not be found past the hole
+        size_t i = hole;
+        while (1) {
+            i = (i + 1) & shard->mask;
+            if (shard->slots[i].orderId == 0) break;
+            size_t home = homeSlot(shard, shard->slots[i].orderId);
+            if (((i - home) & shard->mask) >= ((i - hole) & shard->mask)) {
+                shard->slots[hole] = shard->slots[i];
+                hole = i;
+            }
+        }
+        shard->slots[hole].orderId = 0;
+        shard->slots[hole].order = NULL;
+        shard->count--;
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// the shard lock keeps the order from being released while we read it
+int lookupOrderStatus(OrderIndex *index, int orderId) {
+    if (orderId <= 0) return -1;
+    IndexShard *shard = shardOf(index, orderId);
+    pthread_mutex_lock(&shard->lock);
+    long slot = findSlot(shard, orderId);
+    int status = (slot == -1) ? -1 : readOrderStatus(shard->slots[slot].order);
+    if (slot == -1) {
+        FinishedSlot *finished = finishedSlot(shard, orderId);
+        if (finished->orderId == orderId) status = finished->status;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+// the order stays indexed until the cook or courier holding it drops it
+int cancelIndexedOrder(OrderIndex *index, int orderId) {
+    if (orderId <= 0) return -1;
+    IndexShard *shard = shardOf(index, orderId);
+    pthread_mutex_lock(&shard->lock);
+    long slot = findSlot(shard, orderId);
+    int status = (slot == -1) ? -1 : cancelOrderStatus(shard->slots[slot].order);
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+// the ids are collected under the shard lock and handed to onCancel after it, a journal
+// append that waits for a sync does not hold up the front ends of the shard
+int cancelAllIndexedOrders(OrderIndex *index, void (*onCancel)(int orderId)) {
+    int cancelled = 0;
+    int *ids = NULL;
+    size_t capacity = 0;
+    for (int i = 0; i < ORDER_INDEX_SHARDS; ++i) {
+        IndexShard *shard = &index->shards[i];
+        size_t found = 0;
+        pthread_mutex_lock(&shard->lock);
+        if (onCancel != NULL && shard->count > capacity) {
+            int *grown = (int *)realloc(ids, shard->count * sizeof(int));
+            if (grown != NULL) {
+                ids = grown;
+                capacity = shard->count;
+            }
+        }
+        for (size_t j = 0; j <= shard->mask; ++j) {
+            if (shard->slots[j].orderId != 0 && cancelOrderStatus(shard->slots[j].order) <= ORDER_COOKED) {
+                if (found < capacity) ids[found++] = shard->slots[j].orderId;
+                else if (onCancel != NULL) onCancel(shard->slots[j].orderId); // out of memory, under the lock then
+                cancelled++;
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+        for (size_t j = 0; j < found; ++j) {
+            onCancel(ids[j]);
+        }
+    }
+    free(ids);
+    return cancelled;
+}
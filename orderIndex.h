@@ -0,0 +1,51 @@
+#ifndef ORDER_INDEX_H
+#define ORDER_INDEX_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include "order.h"
+
+#define ORDER_INDEX_SHARDS 64 // must be a power of two
+#define ORDER_INDEX_MIN_SLOTS 256 // per shard, must be a power of two
+#define ORDER_INDEX_ALIGN 64
+#define ORDER_INDEX_FINISHED 1024 // per shard, recently finished orders a status query still answers, a power of two
+
+typedef struct {
+    int32_t orderId; // 0 marks a free slot, ids start at 1
+    Order *order;
+} IndexSlot;
+
+// the final status of an unindexed order, direct mapped by id so a newer one overwrites it
+typedef struct {
+    int32_t orderId;
+    uint8_t status;
+} FinishedSlot;
+
+// open addressing with linear probing. deletes shift the following run back,
+// so there are no tombstones and a lookup stops at the first free slot
+typedef struct {
+    _Alignas(ORDER_INDEX_ALIGN) pthread_mutex_t lock;
+    IndexSlot *slots;
+    size_t mask;
+    size_t count;
+    FinishedSlot finished[ORDER_INDEX_FINISHED];
+} IndexShard;
+
+// orderId -> Order* for every order between createOrders and its release.
+// ids are handed out by one atomic counter and spread round robin over the shards,
+// so a support lookup only locks 1/ORDER_INDEX_SHARDS of the table for a few probes
+typedef struct {
+    _Alignas(ORDER_INDEX_ALIGN) atomic_int nextOrderId;
+    IndexShard shards[ORDER_INDEX_SHARDS];
+} OrderIndex;
+
+void initOrderIndex(OrderIndex *index);
+int reserveOrderIds(OrderIndex *index, int count); // first of count consecutive ids
+int indexOrder(OrderIndex *index, Order *order); // -1 when out of memory
+void unindexOrder(OrderIndex *index, int orderId); // before the order goes back to the pool
+int lookupOrderStatus(OrderIndex *index, int orderId); // OrderStatus, also of the last ORDER_INDEX_SHARDS * ORDER_INDEX_FINISHED finished ones, or -1 for unknown ids
+int cancelIndexedOrder(OrderIndex *index, int orderId); // see cancelOrderStatus, -1 for unknown ids
+int cancelAllIndexedOrders(OrderIndex *index, void (*onCancel)(int orderId)); // number of orders that were still cancellable, onCancel runs for each after its shard is unlocked
+
+#endif
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "orderJournal.h"
+
+JournalRecord *journalBuffers[2];
+int journalActive; // the buffer appenders fill, the writer owns the other one
+int journalFill;
+uint64_t journalAppended; // under journalLock
+atomic_ullong journalDurable;
+atomic_ullong journalSyncCount;
+atomic_int journalRunning;
+int journalStopping;
+int journalFd = -1;
+char journalPath[BUFFER_SIZE];
+long journalBytes; // the file's size, only the writer changes it
+long journalLimit; // 0 compacts only at restart
+long compactAt; // journalBytes that start the next compaction
+pthread_t journalWriter;
+pthread_mutex_t journalLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t journalPending = PTHREAD_COND_INITIALIZER; // the writer waits for records
+pthread_cond_t journalSynced = PTHREAD_COND_INITIALIZER; // a buffer was taken or synced
+__thread uint64_t threadMark;
+
+uint32_t recordCheck(const JournalRecord *record) {
+    const uint8_t *bytes = (const uint8_t *)record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(JournalRecord, check); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void fillRecord(JournalRecord *record, int type, int orderId, int x, int y, int menuItem) {
+    memset(record, 0, sizeof(*record));
+    record->orderId = orderId;
+    record->customerX = (int16_t)x;
+    record->customerY = (int16_t)y;
+    record->type = (uint8_t)type;
+    record->menuItem = (uint8_t)menuItem;
+    record->check = recordCheck(record);
+}
+
+// write may stop early, -1 only on a real error
+int writeRecords(int fd, const JournalRecord *records, int count) {
+    const char *bytes = (const char *)records;
+    size_t left = sizeof(JournalRecord) * count;
+    while (left > 0) {
+        ssize_t written = write(fd, bytes, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        bytes += written;
+        left -= written;
+    }
+    return 0;
+}
+
+void setJournalLimit(long bytes) {
+    journalLimit = bytes;
+}
+
+// the writer's own file is replayed and rewritten, so the live set is exactly what the
+// records on disk say. records appended meanwhile collect in the buffers and go to the new
+// file, replaying it and them gives the same orders as the whole history would
+void compactJournal() {
+    RecoveredOrder *recovered;
+    int maxOrderId;
+    int count = replayJournal(journalPath, &recovered, &maxOrderId);
+    if (count == -1 || rewriteJournal(journalPath, recovered, count, maxOrderId) == -1) {
+        perror("Failed to compact order journal"); // the old file is still whole, it grows on
+        if (count != -1) free(recovered);
+        compactAt = journalBytes + journalLimit;
+        return;
+    }
+    free(recovered);
+    int fd = open(journalPath, O_WRONLY | O_APPEND);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        perror("Failed to reopen order journal");
+        exit(1);
+    }
+    close(journalFd);
+    journalFd = fd;
+    journalBytes = info.st_size;
+    compactAt = journalBytes + journalLimit;
+}
+
+// a record that did not reach the disk may be an order that was acknowledged, the shop
+// cannot keep running on a journal it cannot write
+void *journalWriterThread(void *arg) {
+    pthread_mutex_lock(&journalLock);
+    while (1) {
+        while (journalFill == 0 && !journalStopping) {
+            pthread_cond_wait(&journalPending, &journalLock);
+        }
+        if (journalFill == 0) break; // stopping, and everything is on disk
+        JournalRecord *batch = journalBuffers[journalActive];
+        int count = journalFill;
+        uint64_t upTo = journalAppended;
+        journalActive ^= 1;
+        journalFill = 0;
+        pthread_cond_broadcast(&journalSynced); // appenders waiting for room
+        pthread_mutex_unlock(&journalLock);
+
+        if (writeRecords(journalFd, batch, count) == -1 || fdatasync(journalFd) == -1) {
+            perror("Failed to write order journal");
+            exit(1);
+        }
+        journalBytes += sizeof(JournalRecord) * count;
+
+        pthread_mutex_lock(&journalLock);
+        atomic_store(&journalDurable, upTo);
+        atomic_fetch_add(&journalSyncCount, 1);
+        pthread_cond_broadcast(&journalSynced);
+        if (journalLimit > 0 && journalBytes > compactAt && !journalStopping) {
+            pthread_mutex_unlock(&journalLock);
+            compactJournal();
+            pthread_mutex_lock(&journalLock);
+        }
+    }
+    pthread_mutex_unlock(&journalLock);
+    return NULL;
+}
+
+uint64_t appendRecords(const JournalRecord *records, int count) {
+    if (!atomic_load_explicit(&journalRunning, memory_order_acquire)) return 0;
+    pthread_mutex_lock(&journalLock);
+    while (journalFill + count > JOURNAL_BUFFER_RECORDS) {
+        pthread_cond_wait(&journalSynced, &journalLock);
+    }
+    memcpy(journalBuffers[journalActive] + journalFill, records, sizeof(JournalRecord) * count);
+    if (journalFill == 0) pthread_cond_signal(&journalPending);
+    journalFill += count;
+    journalAppended += count;
+    uint64_t sequence = journalAppended;
+    pthread_mutex_unlock(&journalLock);
+    threadMark = sequence;
+    return sequence;
+}
+
+int openJournal(const char *path) {
+    journalFd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journalFd == -1) return -1;
+    struct stat info;
+    journalBytes = fstat(journalFd, &info) == 0 ? info.st_size : 0;
+    compactAt = journalBytes + journalLimit;
+    snprintf(journalPath, sizeof(journalPath), "%s", path);
+    // kept after closeJournal for an appender that got past the running check, reused here
+    if (journalBuffers[0] == NULL) journalBuffers[0] = (JournalRecord *)malloc(sizeof(JournalRecord) * JOURNAL_BUFFER_RECORDS);
+    if (journalBuffers[1] == NULL) journalBuffers[1] = (JournalRecord *)malloc(sizeof(JournalRecord) * JOURNAL_BUFFER_RECORDS);
+    if (journalBuffers[0] == NULL || journalBuffers[1] == NULL) {
+        perror("Failed to allocate order journal");
+        exit(1);
+    }
+    journalActive = 0;
+    journalFill = 0;
+    journalStopping = 0;
+    atomic_store(&journalRunning, 1);
+    if (pthread_create(&journalWriter, NULL, journalWriterThread, NULL) != 0) {
+        atomic_store(&journalRunning, 0);
+        close(journalFd);
+        journalFd = -1;
+        return -1;
+    }
+    JournalRecord open;
+    fillRecord(&open, JOURNAL_OPEN, JOURNAL_MAGIC, 0, 0, JOURNAL_VERSION);
+    waitJournal(appendRecords(&open, 1));
+    return 0;
+}
+
+// records appended after this are dropped, the buffers stay
+void closeJournal() {
+    if (!atomic_exchange(&journalRunning, 0)) return;
+    pthread_mutex_lock(&journalLock);
+    journalStopping = 1;
+    pthread_cond_signal(&journalPending);
+    pthread_mutex_unlock(&journalLock);
+    pthread_join(journalWriter, NULL);
+    close(journalFd);
+    journalFd = -1;
+}
+
+uint64_t journalOrders(Order **orders, int count) {
+    JournalRecord records[64];
+    uint64_t sequence = 0;
+    for (int done = 0; done < count; ) {
+        int batch = (count - done > 64) ? 64 : count - done;
+        for (int i = 0; i < batch; ++i) {
+            Order *order = orders[done + i];
+            fillRecord(&records[i], JOURNAL_CREATED, order->orderId, order->customerX, order->customerY, order->menuItem);
+        }
+        sequence = appendRecords(records, batch);
+        done += batch;
+    }
+    return sequence;
+}
+
+uint64_t journalStage(int orderId, int type) {
+    JournalRecord record;
+    fillRecord(&record, type, orderId, 0, 0, 0);
+    return appendRecords(&record, 1);
+}
+
+uint64_t journalMark() {
+    return threadMark;
+}
+
+void waitJournal(uint64_t sequence) {
+    if (sequence <= atomic_load_explicit(&journalDurable, memory_order_acquire)) return;
+    pthread_mutex_lock(&journalLock);
+    while (atomic_load(&journalDurable) < sequence) {
+        pthread_cond_wait(&journalSynced, &journalLock);
+    }
+    pthread_mutex_unlock(&journalLock);
+}
+
+uint64_t durableRecords() {
+    return atomic_load_explicit(&journalDurable, memory_order_relaxed);
+}
+
+uint64_t journalSyncs() {
+    return atomic_load_explicit(&journalSyncCount, memory_order_relaxed);
+}
+
+// the latest stage of each order id seen, 0 for ids without a JOURNAL_CREATED
+typedef struct {
+    int16_t customerX, customerY;
+    uint8_t menuItem;
+    uint8_t stage;
+} ReplayEntry;
+
+int replayJournal(const char *path, RecoveredOrder **orders, int *maxOrderId) {
+    *orders = NULL;
+    *maxOrderId = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return errno == ENOENT ? 0 : -1;
+
+    JournalRecord *chunk = (JournalRecord *)malloc(sizeof(JournalRecord) * JOURNAL_READ_RECORDS);
+    ReplayEntry *entries = NULL;
+    int capacity = 0, maxId = 0, lastCreated = 0, first = 1, torn = 0;
+    size_t carry = 0; // bytes of a record split over two reads
+    while (!torn) {
+        ssize_t got = read(fd, (char *)chunk + carry, sizeof(JournalRecord) * JOURNAL_READ_RECORDS - carry);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break; // a partial record left at the end was torn
+        size_t bytes = carry + got, count = bytes / sizeof(JournalRecord);
+        for (size_t i = 0; i < count; ++i) {
+            JournalRecord *record = &chunk[i];
+            if (record->check != recordCheck(record) || (first && (record->type != JOURNAL_OPEN || record->orderId != JOURNAL_MAGIC))) {
+                if (first) {
+                    free(chunk);
+                    close(fd);
+                    errno = EINVAL; // not a journal
+                    return -1;
+                }
+                torn = 1;
+                break;
+            }
+            first = 0;
+            int id = record->orderId;
+            if (record->type == JOURNAL_IDS && id > maxId) maxId = id;
+            if (record->type == JOURNAL_OPEN || record->type == JOURNAL_IDS || id <= 0) continue;
+            if (id >= capacity) {
+                if (record->type != JOURNAL_CREATED) continue; // a stage of an order this file does not know
+                int grown = capacity > 0 ? capacity : 1024;
+                while (grown <= id) grown *= 2;
+                entries = (ReplayEntry *)realloc(entries, sizeof(ReplayEntry) * grown);
+                if (entries == NULL) {
+                    perror("Failed to replay order journal");
+                    exit(1);
+                }
+                memset(entries + capacity, 0, sizeof(ReplayEntry) * (grown - capacity));
+                capacity = grown;
+            }
+            ReplayEntry *entry = &entries[id];
+            if (record->type == JOURNAL_CREATED) {
+                entry->customerX = record->customerX;
+                entry->customerY = record->customerY;
+                entry->menuItem = record->menuItem;
+                entry->stage = JOURNAL_CREATED;
+                if (id > lastCreated) lastCreated = id;
+            } else if (entry->stage != 0 && entry->stage != JOURNAL_DELIVERED && entry->stage != JOURNAL_CANCELLED) {
+                entry->stage = record->type; // a cancel can land after the bake it raced, a finished order stays finished
+            }
+        }
+        carry = bytes - count * sizeof(JournalRecord);
+        memmove(chunk, (char *)chunk + count * sizeof(JournalRecord), carry);
+    }
+    free(chunk);
+    close(fd);
+
+    int live = 0;
+    for (int id = 1; id <= lastCreated; ++id) {
+        if (entries[id].stage >= JOURNAL_CREATED && entries[id].stage <= JOURNAL_DELIVERING) live++;
+    }
+    RecoveredOrder *recovered = (RecoveredOrder *)malloc(sizeof(RecoveredOrder) * (live > 0 ? live : 1));
+    if (recovered == NULL) {
+        perror("Failed to replay order journal");
+        exit(1);
+    }
+    int count = 0;
+    for (int id = 1; id <= lastCreated; ++id) {
+        ReplayEntry *entry = &entries[id];
+        if (entry->stage < JOURNAL_CREATED || entry->stage > JOURNAL_DELIVERING) continue;
+        RecoveredOrder *order = &recovered[count++];
+        order->orderId = id;
+        order->customerX = entry->customerX;
+        order->customerY = entry->customerY;
+        order->menuItem = entry->menuItem;
+        // a meal in preparation or in the oven is started over, one that was baked or on the road goes out again
+        order->status = (entry->stage == JOURNAL_CREATED) ? ORDER_RECEIVED : ORDER_COOKED;
+    }
+    free(entries);
+    *orders = recovered;
+    *maxOrderId = maxId > lastCreated ? maxId : lastCreated;
+    return count;
+}
+
+// the directory entry of the rename has to reach the disk too
+int syncDirectoryOf(const char *path) {
+    char directory[BUFFER_SIZE];
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        strcpy(directory, ".");
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - path) + (slash == path), path);
+    }
+    int fd = open(directory, O_RDONLY);
+    if (fd == -1) return -1;
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+int rewriteJournal(const char *path, const RecoveredOrder *orders, int count, int maxOrderId) {
+    char temporary[BUFFER_SIZE];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return -1;
+
+    JournalRecord records[2 * 256];
+    int filled = 0, failed = 0;
+    fillRecord(&records[filled++], JOURNAL_OPEN, JOURNAL_MAGIC, 0, 0, JOURNAL_VERSION);
+    fillRecord(&records[filled++], JOURNAL_IDS, maxOrderId, 0, 0, 0); // ids of finished orders are not handed out again
+    for (int i = 0; i < count && !failed; ++i) {
+        const RecoveredOrder *order = &orders[i];
+        fillRecord(&records[filled++], JOURNAL_CREATED, order->orderId, order->customerX, order->customerY, order->menuItem);
+        if (order->status == ORDER_COOKED) fillRecord(&records[filled++], JOURNAL_BAKED, order->orderId, 0, 0, 0);
+        if (filled > 2 * 256 - 2) {
+            failed = writeRecords(fd, records, filled) == -1;
+            filled = 0;
+        }
+    }
+    if (failed || writeRecords(fd, records, filled) == -1 || fdatasync(fd) == -1) {
+        close(fd);
+        unlink(temporary);
+        return -1;
+    }
+    close(fd);
+    if (rename(temporary, path) == -1) {
+        unlink(temporary);
+        return -1;
+    }
+    return syncDirectoryOf(path);
+}
@@ -0,0 +1,64 @@
+#ifndef ORDER_JOURNAL_H
+#define ORDER_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "order.h"
+
+#define JOURNAL_MAGIC 0x4C4E524A // "JRNL", orderId of the JOURNAL_OPEN record that starts a file
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUFFER_RECORDS 65536 // per buffer, appenders wait while both are full
+#define JOURNAL_READ_RECORDS 65536 // replay reads the file this many records at a time
+
+// what happened to an order. replay only needs the stages that decide where it goes back:
+// created orders to the kitchen, baked or driven ones to the couriers, the rest nowhere
+#define JOURNAL_OPEN 0 // orderId JOURNAL_MAGIC, menuItem JOURNAL_VERSION
+#define JOURNAL_CREATED 1 // orderId x y menuItem
+#define JOURNAL_BAKED 2 // out of the oven, waiting for a courier
+#define JOURNAL_DELIVERING 3 // a courier drove off with it, it can no longer be cancelled
+#define JOURNAL_DELIVERED 4
+#define JOURNAL_CANCELLED 5
+#define JOURNAL_IDS 6 // orderId is the highest id handed out before the journal was rewritten
+
+// 16 bytes on disk, a record torn by a crash fails its check and ends the replay
+typedef struct {
+    int32_t orderId;
+    int16_t customerX, customerY;
+    uint8_t type;
+    uint8_t menuItem;
+    uint16_t reserved;
+    uint32_t check; // FNV-1a over the 12 bytes above
+} JournalRecord;
+
+// an order replay found created and not finished, status is ORDER_RECEIVED or ORDER_COOKED
+typedef struct {
+    int32_t orderId;
+    int16_t customerX, customerY;
+    uint8_t menuItem;
+    uint8_t status;
+} RecoveredOrder;
+
+// appenders copy records into a shared buffer and get a sequence number back, a writer
+// thread writes the buffer out and fdatasyncs it while the next batch collects in the other
+// one. one sync covers every record appended during the previous one, so its cost is shared
+// by however many orders arrived meanwhile. every call is a no-op while no journal is open.
+// once the file grew by the limit since it was opened or last compacted, the writer replays
+// it and rewrites it to the unfinished orders. appends wait for that only if both buffers fill
+void setJournalLimit(long bytes); // before openJournal, 0 leaves compaction to the restart
+int openJournal(const char *path); // appends, -1 when the file cannot be opened or the writer cannot start
+void closeJournal(); // writes and syncs what is buffered
+uint64_t journalOrders(Order **orders, int count); // JOURNAL_CREATED for each, returns the sequence of the last
+uint64_t journalStage(int orderId, int type);
+uint64_t journalMark(); // the last sequence this thread appended
+void waitJournal(uint64_t sequence); // until every record up to sequence is on disk
+uint64_t durableRecords(); // for metrics
+uint64_t journalSyncs();
+
+// reads a journal and returns its unfinished orders in id order through *orders, the caller
+// frees them. *maxOrderId is the highest id it saw. 0 orders for a missing file, -1 when it
+// cannot be read. records after a torn or foreign one are ignored
+int replayJournal(const char *path, RecoveredOrder **orders, int *maxOrderId);
+// replaces the journal with one holding only these orders and maxOrderId, through a synced rename
+int rewriteJournal(const char *path, const RecoveredOrder *orders, int count, int maxOrderId);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "orderPool.h"
+
+typedef struct {
+    Order *head;
+    int count;
+    int watched; // the exit hook of this thread is set
+} OrderCache;
+
+__thread OrderCache orderCache;
+pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t cacheKey; // only for its destructor, which runs when a thread with a cache exits
+
+pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+Order **magazines = NULL; // each entry heads a chain of ORDER_MAGAZINE_SIZE free orders
+int magazineCount = 0;
+int magazineCapacity = 0;
+Order *slabCursor = NULL;
+int slabLeft = 0;
+size_t slabCount = 0;
+Order *looseOrders = NULL; // left by exited threads, cut into magazines once there are enough
+int looseCount = 0;
+
+void cacheExited(void *cache) {
+    flushOrderCache();
+}
+
+void createCacheKey() {
+    pthread_key_create(&cacheKey, cacheExited);
+}
+
+// a destructor only runs for a non-NULL value, the cache itself serves as one
+void watchCache() {
+    pthread_once(&cacheKeyOnce, createCacheKey);
+    pthread_setspecific(cacheKey, &orderCache);
+    orderCache.watched = 1;
+}
+
+// pool lock held, -1 when the stack cannot grow
+int pushMagazine(Order *chain) {
+    if (magazineCount == magazineCapacity) {
+        int capacity = magazineCapacity ? magazineCapacity * 2 : 64;
+        Order **grown = (Order **)realloc(magazines, sizeof(Order *) * capacity);
+        if (grown == NULL) return -1;
+        magazines = grown;
+        magazineCapacity = capacity;
+    }
+    magazines[magazineCount++] = chain;
+    return 0;
+}
+
+// gives the calling thread one magazine, from the shared stack or from a fresh slab
+int refillCache() {
+    if (!orderCache.watched) watchCache();
+    pthread_mutex_lock(&poolLock);
+    if (magazineCount > 0) {
+        orderCache.head = magazines[--magazineCount];
+        orderCache.count = ORDER_MAGAZINE_SIZE;
+        pthread_mutex_unlock(&poolLock);
+        return 0;
+    }
+    if (looseCount > 0) { // fewer than a magazine, unless the stack could not grow
+        orderCache.head = looseOrders;
+        orderCache.count = looseCount;
+        looseOrders = NULL;
+        looseCount = 0;
+        pthread_mutex_unlock(&poolLock);
+        return 0;
+    }
+    if (slabLeft < ORDER_MAGAZINE_SIZE) {
+        slabCursor = (Order *)malloc(sizeof(Order) * ORDER_SLAB_SIZE);
+        if (slabCursor == NULL) {
+            slabLeft = 0;
+            pthread_mutex_unlock(&poolLock);
+            return -1;
+        }
+        slabLeft = ORDER_SLAB_SIZE;
+        slabCount++;
+    }
+    Order *chain = slabCursor;
+    slabCursor += ORDER_MAGAZINE_SIZE;
+    slabLeft -= ORDER_MAGAZINE_SIZE;
+    pthread_mutex_unlock(&poolLock);
+
+    for (int i = 0; i < ORDER_MAGAZINE_SIZE - 1; ++i) {
+        chain[i].next = &chain[i + 1];
+    }
+    chain[ORDER_MAGAZINE_SIZE - 1].next = NULL;
+    orderCache.head = chain;
+    orderCache.count = ORDER_MAGAZINE_SIZE;
+    return 0;
+}
+
+// hands one magazine back once a thread, typically a courier, holds two of them
+void spillCache() {
+    Order *chain = orderCache.head;
+    Order *last = chain;
+    for (int i = 1; i < ORDER_MAGAZINE_SIZE; ++i) {
+        last = last->next;
+    }
+    orderCache.head = last->next;
+    orderCache.count -= ORDER_MAGAZINE_SIZE;
+    last->next = NULL;
+
+    pthread_mutex_lock(&poolLock);
+    if (pushMagazine(chain) == -1) { // keep the orders in this thread rather than lose them
+        pthread_mutex_unlock(&poolLock);
+        last->next = orderCache.head;
+        orderCache.head = chain;
+        orderCache.count += ORDER_MAGAZINE_SIZE;
+        return;
+    }
+    pthread_mutex_unlock(&poolLock);
+}
+
+// the cache goes to the loose orders, whole magazines of them back on the stack
+void flushOrderCache() {
+    Order *chain = orderCache.head;
+    if (chain == NULL) return;
+    Order *last = chain;
+    while (last->next != NULL) {
+        last = last->next;
+    }
+    pthread_mutex_lock(&poolLock);
+    last->next = looseOrders;
+    looseOrders = chain;
+    looseCount += orderCache.count;
+    while (looseCount >= ORDER_MAGAZINE_SIZE) {
+        Order *magazine = looseOrders, *end = magazine;
+        for (int i = 1; i < ORDER_MAGAZINE_SIZE; ++i) {
+            end = end->next;
+        }
+        Order *rest = end->next;
+        end->next = NULL;
+        if (pushMagazine(magazine) == -1) {
+            end->next = rest;
+            break;
+        }
+        looseOrders = rest;
+        looseCount -= ORDER_MAGAZINE_SIZE;
+    }
+    pthread_mutex_unlock(&poolLock);
+    orderCache.head = NULL;
+    orderCache.count = 0;
+}
+
+Order *allocOrder() {
+    if (orderCache.head == NULL && refillCache() == -1) return NULL;
+    Order *order = orderCache.head;
+    orderCache.head = order->next;
+    orderCache.count--;
+    order->next = NULL;
+    return order;
+}
+
+// returns -1 when out of memory, nothing is kept from a partial batch
+int allocOrders(Order **orders, int count) {
+    for (int i = 0; i < count; ++i) {
+        orders[i] = allocOrder();
+        if (orders[i] == NULL) {
+            while (i-- > 0) releaseOrder(orders[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void releaseOrder(Order *order) {
+    if (!orderCache.watched) watchCache(); // couriers release orders they never allocated
+    order->next = orderCache.head;
+    orderCache.head = order;
+    if (++orderCache.count >= 2 * ORDER_MAGAZINE_SIZE) {
+        spillCache();
+    }
+}
+
+size_t orderPoolBytes() {
+    pthread_mutex_lock(&poolLock);
+    size_t bytes = slabCount * ORDER_SLAB_SIZE * sizeof(Order);
+    pthread_mutex_unlock(&poolLock);
+    return bytes;
+}
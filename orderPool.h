@@ -0,0 +1,20 @@
+#ifndef ORDER_POOL_H
+#define ORDER_POOL_H
+
+#include <stddef.h>
+#include "order.h"
+
+#define ORDER_SLAB_SIZE 4096 // orders carved out of one malloc
+#define ORDER_MAGAZINE_SIZE 64 // orders moved between a thread cache and the shared pool at once
+
+// every thread keeps a private free list of orders. it refills from and spills to a shared
+// stack of full magazines, so the pool lock is taken once per ORDER_MAGAZINE_SIZE orders.
+// orders can be released by a different thread than the one that allocated them. a thread
+// that exits hands its cache back through a thread key destructor
+Order *allocOrder();
+int allocOrders(Order **orders, int count);
+void releaseOrder(Order *order);
+void flushOrderCache(); // gives this thread's cached orders back to the shared pool
+size_t orderPoolBytes(); // memory held by slabs, in use or free
+
+#endif
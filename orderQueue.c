@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "orderQueue.h"
+
+void futexWait(atomic_uint *word, unsigned int expected) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+void futexWake(atomic_uint *word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// the fence pairs with the one a parking thread issues after announcing itself,
+// so either the waiter sees the new cell or we see the waiter
+void wakeWaiters(atomic_uint *word, atomic_int *waiters, int count) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(word, 1);
+        futexWake(word, count);
+    }
+}
+
+void initQueue(OrderQueue *queue) {
+    queue->cells = (QueueCell *)malloc(sizeof(QueueCell) * ORDER_QUEUE_CAPACITY);
+    if (queue->cells == NULL) {
+        perror("Failed to allocate order queue");
+        exit(1);
+    }
+    queue->mask = ORDER_QUEUE_CAPACITY - 1;
+    for (size_t i = 0; i < ORDER_QUEUE_CAPACITY; ++i) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].order = NULL;
+    }
+    atomic_init(&queue->enqueuePos, 0);
+    atomic_init(&queue->dequeuePos, 0);
+    atomic_init(&queue->notEmpty, 0);
+    atomic_init(&queue->emptyWaiters, 0);
+    atomic_init(&queue->notFull, 0);
+    atomic_init(&queue->fullWaiters, 0);
+}
+
+// returns 0 when the ring is full
+int tryEnqueue(OrderQueue *queue, Order *order) {
+    size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    QueueCell *cell;
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->order = order;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return 1;
+}
+
+Order *tryDequeue(OrderQueue *queue) {
+    size_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    QueueCell *cell;
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+        }
+    }
+    Order *order = cell->order;
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    wakeWaiters(&queue->notFull, &queue->fullWaiters, 1);
+    return order;
+}
+
+void enqueue(OrderQueue *queue, Order *order) {
+    order->next = NULL;
+    for (int spin = 0; !tryEnqueue(queue, order); ++spin) {
+        if (spin < QUEUE_SPIN_LIMIT) continue;
+        if (spin < QUEUE_SPIN_LIMIT + QUEUE_YIELD_LIMIT) {
+            sched_yield();
+            continue;
+        }
+        unsigned int seen = atomic_load(&queue->notFull);
+        atomic_fetch_add(&queue->fullWaiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (tryEnqueue(queue, order)) {
+            atomic_fetch_sub(&queue->fullWaiters, 1);
+            break;
+        }
+        futexWait(&queue->notFull, seen);
+        atomic_fetch_sub(&queue->fullWaiters, 1);
+    }
+    wakeWaiters(&queue->notEmpty, &queue->emptyWaiters, 1);
+}
+
+// claims count consecutive cells with one CAS when the ring has room for all of them,
+// otherwise falls back to one enqueue per order
+void enqueueBatch(OrderQueue *queue, Order **orders, int count) {
+    if (count <= 0) return;
+    size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    while (count <= (int)queue->mask + 1) {
+        int fits = 1;
+        for (int i = 0; i < count; ++i) {
+            size_t seq = atomic_load_explicit(&queue->cells[(pos + i) & queue->mask].sequence, memory_order_acquire);
+            if (seq != pos + i) {
+                fits = 0;
+                break;
+            }
+        }
+        if (!fits) {
+            size_t now = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+            if (now == pos) break; // not enough free cells
+            pos = now;
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + count, memory_order_relaxed, memory_order_relaxed)) {
+            for (int i = 0; i < count; ++i) {
+                QueueCell *cell = &queue->cells[(pos + i) & queue->mask];
+                orders[i]->next = NULL;
+                cell->order = orders[i];
+                atomic_store_explicit(&cell->sequence, pos + i + 1, memory_order_release);
+            }
+            wakeWaiters(&queue->notEmpty, &queue->emptyWaiters, count);
+            return;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        enqueue(queue, orders[i]);
+    }
+}
+
+Order *dequeue(OrderQueue *queue) {
+    Order *order;
+    for (int spin = 0; (order = tryDequeue(queue)) == NULL; ++spin) {
+        if (spin < QUEUE_SPIN_LIMIT) continue;
+        if (spin < QUEUE_SPIN_LIMIT + QUEUE_YIELD_LIMIT) {
+            sched_yield();
+            continue;
+        }
+        unsigned int seen = atomic_load(&queue->notEmpty);
+        atomic_fetch_add(&queue->emptyWaiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        order = tryDequeue(queue);
+        if (order == NULL) futexWait(&queue->notEmpty, seen);
+        atomic_fetch_sub(&queue->emptyWaiters, 1);
+        if (order != NULL) break;
+    }
+    return order;
+}
+
+// approximate while producers or consumers are running
+size_t queueLength(OrderQueue *queue) {
+    size_t head = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
+
+void initLockedQueue(LockedOrderQueue *queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+    pthread_mutex_init(&queue->queueLock, NULL);
+    pthread_cond_init(&queue->queueCond, NULL);
+}
+
+void lockedEnqueue(LockedOrderQueue *queue, Order *order) {
+    order->next = NULL;
+    pthread_mutex_lock(&queue->queueLock);
+    if (queue->tail == NULL) {
+        queue->head = order;
+        queue->tail = order;
+    } else {
+        queue->tail->next = order;
+        queue->tail = order;
+    }
+    pthread_cond_signal(&queue->queueCond);
+    pthread_mutex_unlock(&queue->queueLock);
+}
+
+Order *lockedDequeue(LockedOrderQueue *queue) {
+    pthread_mutex_lock(&queue->queueLock);
+    while (queue->head == NULL) {
+        pthread_cond_wait(&queue->queueCond, &queue->queueLock);
+    }
+    Order *order = queue->head;
+    queue->head = order->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    pthread_mutex_unlock(&queue->queueLock);
+    return order;
+}
@@ -0,0 +1,55 @@
+#ifndef ORDER_QUEUE_H
+#define ORDER_QUEUE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include "order.h"
+
+#define ORDER_QUEUE_CAPACITY 65536 // must be a power of two
+#define CACHE_LINE_SIZE 64
+#define QUEUE_SPIN_LIMIT 100 // failed tries before a thread starts yielding
+#define QUEUE_YIELD_LIMIT 4 // sched_yield rounds before it parks on the futex
+
+typedef struct {
+    atomic_size_t sequence;
+    Order *order;
+} QueueCell;
+
+// the server no longer links this, cooks and couriers take work from WorkScheduler. the ring
+// stays as the baseline queueBench and schedulerBench measure the older designs against.
+//
+// bounded lock-free multi producer / multi consumer ring (cell sequence numbers, one CAS per
+// operation). consumers park on a futex while it is empty, producers while it is full.
+// every counter that is written by a different side sits on its own cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueuePos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeuePos;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint notEmpty; // futex words, bumped before every wake up
+    atomic_int emptyWaiters;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint notFull;
+    atomic_int fullWaiters;
+    _Alignas(CACHE_LINE_SIZE) QueueCell *cells;
+    size_t mask;
+} OrderQueue;
+
+// the old linked list behind one mutex and condition variable, kept for queueBench
+typedef struct {
+    Order *head;
+    Order *tail;
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueCond;
+} LockedOrderQueue;
+
+void initQueue(OrderQueue *queue);
+void enqueue(OrderQueue *queue, Order *order);
+void enqueueBatch(OrderQueue *queue, Order **orders, int count);
+Order *dequeue(OrderQueue *queue);
+Order *tryDequeue(OrderQueue *queue);
+size_t queueLength(OrderQueue *queue);
+
+void initLockedQueue(LockedOrderQueue *queue);
+void lockedEnqueue(LockedOrderQueue *queue, Order *order);
+Order *lockedDequeue(LockedOrderQueue *queue);
+
+#endif
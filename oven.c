@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <time.h>
+#include "oven.h"
+
+void initOvenManager(OvenManager *manager) {
+    pthread_mutex_init(&manager->lock, NULL);
+    pthread_cond_init(&manager->slotFree, NULL);
+    for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
+        for (int j = 0; j < MAX_OVEN_CAPACITY; ++j) {
+            manager->ovens[i].slots[j] = NULL;
+        }
+        manager->ovens[i].mealsInside = 0;
+    }
+    manager->freeSlots = MAX_OVEN_APARATUS * MAX_OVEN_CAPACITY;
+    manager->waitingCooks = 0;
+}
+
+void destroyOvenManager(OvenManager *manager) {
+    pthread_mutex_destroy(&manager->lock);
+    pthread_cond_destroy(&manager->slotFree);
+}
+
+// slots are numbered oven * MAX_OVEN_CAPACITY + position
+int ovenOfSlot(int slot) {
+    return slot / MAX_OVEN_CAPACITY;
+}
+
+// the emptiest oven spreads the meals so no single oven runs full while others idle
+int placeInOven(OvenManager *manager, Order *order) {
+    pthread_mutex_lock(&manager->lock);
+    while (manager->freeSlots == 0) {
+        manager->waitingCooks++;
+        pthread_cond_wait(&manager->slotFree, &manager->lock);
+        manager->waitingCooks--;
+    }
+    int best = 0;
+    for (int i = 1; i < MAX_OVEN_APARATUS; ++i) {
+        if (manager->ovens[i].mealsInside < manager->ovens[best].mealsInside) best = i;
+    }
+    Oven *oven = &manager->ovens[best];
+    int position = 0;
+    while (oven->slots[position] != NULL) {
+        position++;
+    }
+    oven->slots[position] = order;
+    oven->mealsInside++;
+    manager->freeSlots--;
+    pthread_mutex_unlock(&manager->lock);
+    return best * MAX_OVEN_CAPACITY + position;
+}
+
+Order *removeFromOven(OvenManager *manager, int slot) {
+    Oven *oven = &manager->ovens[ovenOfSlot(slot)];
+    pthread_mutex_lock(&manager->lock);
+    Order *order = oven->slots[slot % MAX_OVEN_CAPACITY];
+    oven->slots[slot % MAX_OVEN_CAPACITY] = NULL;
+    oven->mealsInside--;
+    manager->freeSlots++;
+    if (manager->waitingCooks > 0) pthread_cond_signal(&manager->slotFree);
+    pthread_mutex_unlock(&manager->lock);
+    return order;
+}
+
+int freeOvenSlots(OvenManager *manager) {
+    pthread_mutex_lock(&manager->lock);
+    int free = manager->freeSlots;
+    pthread_mutex_unlock(&manager->lock);
+    return free;
+}
+
+int mealsInOven(OvenManager *manager, int oven) {
+    return __atomic_load_n(&manager->ovens[oven].mealsInside, __ATOMIC_RELAXED);
+}
+
+int cooksWaitingForOven(OvenManager *manager) {
+    return __atomic_load_n(&manager->waitingCooks, __ATOMIC_RELAXED);
+}
+
+long ovenClockNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void siftUp(BakeTimer *timers, int i) {
+    while (i > 0 && timers[(i - 1) / 2].doneNs > timers[i].doneNs) {
+        BakeTimer swap = timers[i];
+        timers[i] = timers[(i - 1) / 2];
+        timers[(i - 1) / 2] = swap;
+        i = (i - 1) / 2;
+    }
+}
+
+void siftDown(BakeTimer *timers, int count, int i) {
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < count && timers[left].doneNs < timers[smallest].doneNs) smallest = left;
+        if (right < count && timers[right].doneNs < timers[smallest].doneNs) smallest = right;
+        if (smallest == i) return;
+        BakeTimer swap = timers[i];
+        timers[i] = timers[smallest];
+        timers[smallest] = swap;
+        i = smallest;
+    }
+}
+
+// takes meals out when their timer runs out, the callback runs without the oven lock
+void *ovenTimerThread(void *arg) {
+    OvenManager *manager = (OvenManager *)arg;
+    pthread_mutex_lock(&manager->lock);
+    while (!manager->timerStopping) {
+        if (manager->timerCount == 0) {
+            pthread_cond_wait(&manager->timerChanged, &manager->lock);
+            continue;
+        }
+        long doneNs = manager->timers[0].doneNs;
+        if (doneNs > ovenClockNs()) {
+            struct timespec until = { doneNs / 1000000000L, doneNs % 1000000000L };
+            pthread_cond_timedwait(&manager->timerChanged, &manager->lock, &until);
+            continue;
+        }
+        int slot = manager->timers[0].slot;
+        manager->timers[0] = manager->timers[--manager->timerCount];
+        siftDown(manager->timers, manager->timerCount, 0);
+        pthread_mutex_unlock(&manager->lock);
+
+        Order *order = removeFromOven(manager, slot);
+        manager->baked(order, slot, manager->bakedCtx);
+        pthread_mutex_lock(&manager->lock);
+    }
+    pthread_mutex_unlock(&manager->lock);
+    return NULL;
+}
+
+int startOvenTimer(OvenManager *manager, BakedCallback baked, void *ctx) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&manager->timerChanged, &attr);
+    pthread_condattr_destroy(&attr);
+    manager->timerCount = 0;
+    manager->timerStopping = 0;
+    manager->baked = baked;
+    manager->bakedCtx = ctx;
+    return pthread_create(&manager->timerThread, NULL, ovenTimerThread, manager) == 0 ? 0 : -1;
+}
+
+void stopOvenTimer(OvenManager *manager) {
+    pthread_mutex_lock(&manager->lock);
+    manager->timerStopping = 1;
+    pthread_cond_signal(&manager->timerChanged);
+    pthread_mutex_unlock(&manager->lock);
+    if (pthread_equal(pthread_self(), manager->timerThread)) return; // a signal handler on the timer thread itself
+    pthread_join(manager->timerThread, NULL);
+    pthread_cond_destroy(&manager->timerChanged);
+}
+
+int bakeInOven(OvenManager *manager, Order *order, long bakeNs) {
+    int slot = placeInOven(manager, order);
+    stampOrder(order, STAMP_PLACED); // the timer is not set yet, nothing else holds the order
+    pthread_mutex_lock(&manager->lock);
+    BakeTimer *timer = &manager->timers[manager->timerCount];
+    timer->doneNs = ovenClockNs() + bakeNs;
+    timer->slot = slot;
+    siftUp(manager->timers, manager->timerCount++);
+    if (manager->timers[0].slot == slot) pthread_cond_signal(&manager->timerChanged); // new earliest meal
+    pthread_mutex_unlock(&manager->lock);
+    return slot;
+}
@@ -0,0 +1,56 @@
+#ifndef OVEN_H
+#define OVEN_H
+
+#include <pthread.h>
+#include "order.h"
+
+#define MAX_OVEN_APARATUS 3
+#define MAX_OVEN_CAPACITY 6
+#define OVEN_SLOTS (MAX_OVEN_APARATUS * MAX_OVEN_CAPACITY)
+
+typedef struct {
+    Order *slots[MAX_OVEN_CAPACITY]; // NULL for a free slot
+    int mealsInside;
+} Oven;
+
+typedef struct {
+    long doneNs; // CLOCK_MONOTONIC
+    int slot;
+} BakeTimer;
+
+// called on the oven timer thread after a meal left its slot
+typedef void (*BakedCallback)(Order *order, int slot, void *ctx);
+
+// all ovens behind one lock, the state is a few dozen bytes and every placement has to
+// compare all ovens anyway. cooks with nothing to place sleep on slotFree instead of polling
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t slotFree;
+    Oven ovens[MAX_OVEN_APARATUS];
+    int freeSlots;
+    int waitingCooks;
+    // bakeInOven meals, a min heap on doneNs. one thread sleeps until the earliest is done,
+    // so the cook that placed a meal can go back to preparing instead of waiting for it
+    pthread_cond_t timerChanged;
+    BakeTimer timers[OVEN_SLOTS];
+    int timerCount;
+    int timerStopping;
+    pthread_t timerThread;
+    BakedCallback baked;
+    void *bakedCtx;
+} OvenManager;
+
+void initOvenManager(OvenManager *manager);
+void destroyOvenManager(OvenManager *manager);
+int placeInOven(OvenManager *manager, Order *order); // blocks while every slot is taken, returns the slot
+Order *removeFromOven(OvenManager *manager, int slot); // the order placed in that slot
+int ovenOfSlot(int slot);
+int freeOvenSlots(OvenManager *manager);
+// read without the lock for metrics, may be a meal behind
+int mealsInOven(OvenManager *manager, int oven);
+int cooksWaitingForOven(OvenManager *manager);
+int startOvenTimer(OvenManager *manager, BakedCallback baked, void *ctx);
+void stopOvenTimer(OvenManager *manager); // meals still baking stay in their slots
+int bakeInOven(OvenManager *manager, Order *order, long bakeNs); // placeInOven, removed by the timer thread
+
+#endif
@@ -0,0 +1,86 @@
+// queueBench.c
+// compares the lock-free OrderQueue ring with the old mutex/condvar LockedOrderQueue.
+// every thread owns one order and keeps enqueueing it and dequeueing whatever is next,
+// so all threads are producers and consumers at the same time
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "orderQueue.h"
+
+#define OPERATIONS_PER_RUN 2000000
+
+typedef struct {
+    int iterations;
+    Order *order;
+    pthread_t thread;
+} BenchThread;
+
+OrderQueue ringQueue;
+LockedOrderQueue lockedQueue;
+pthread_barrier_t startBarrier;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void *ringThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    Order *order = bench->order;
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->iterations; ++i) {
+        enqueue(&ringQueue, order);
+        order = dequeue(&ringQueue);
+    }
+    return NULL;
+}
+
+void *lockedThread(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    Order *order = bench->order;
+    pthread_barrier_wait(&startBarrier);
+    for (int i = 0; i < bench->iterations; ++i) {
+        lockedEnqueue(&lockedQueue, order);
+        order = lockedDequeue(&lockedQueue);
+    }
+    return NULL;
+}
+
+// returns enqueue+dequeue pairs per second
+double runBench(int threadCount, void *(*body)(void *)) {
+    BenchThread *threads = calloc(threadCount, sizeof(BenchThread));
+    Order *orders = calloc(threadCount, sizeof(Order));
+    pthread_barrier_init(&startBarrier, NULL, threadCount + 1);
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].iterations = OPERATIONS_PER_RUN / threadCount;
+        threads[i].order = &orders[i];
+        pthread_create(&threads[i].thread, NULL, body, &threads[i]);
+    }
+    pthread_barrier_wait(&startBarrier);
+    long start = nowNs();
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+    pthread_barrier_destroy(&startBarrier);
+    free(orders);
+    free(threads);
+    return (OPERATIONS_PER_RUN / threadCount) * threadCount / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    int threadCounts[] = { 1, 4, 16, 64 };
+    initQueue(&ringQueue);
+    initLockedQueue(&lockedQueue);
+
+    printf("%-8s %18s %18s %8s\n", "threads", "mutex queue op/s", "lock-free op/s", "speedup");
+    for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i) {
+        double locked = runBench(threadCounts[i], lockedThread);
+        double ring = runBench(threadCounts[i], ringThread);
+        printf("%-8d %18.0f %18.0f %7.2fx\n", threadCounts[i], locked, ring, ring / locked);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+// randomBench.c
+// cook threads filling 30x40 complex recipe matrices (2400 draws per preparation step),
+// glibc rand() behind its global lock against the per-thread fastRandom streams
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "fastRandom.h"
+
+#define RECIPE_VALUES (30 * 40 * 2)
+#define STEPS_PER_RUN 20000
+
+typedef struct {
+    int id;
+    int steps;
+    double checksum; // keeps the fills from being optimized away
+    pthread_t thread;
+} BenchCook;
+
+pthread_barrier_t startBarrier;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void *globalRandCook(void *arg) {
+    BenchCook *cook = (BenchCook *)arg;
+    double recipe[RECIPE_VALUES];
+    pthread_barrier_wait(&startBarrier);
+    for (int step = 0; step < cook->steps; ++step) {
+        for (int i = 0; i < RECIPE_VALUES; ++i) {
+            recipe[i] = rand() % 10;
+        }
+        cook->checksum += recipe[step % RECIPE_VALUES];
+    }
+    return NULL;
+}
+
+void *fastRandomCook(void *arg) {
+    BenchCook *cook = (BenchCook *)arg;
+    double recipe[RECIPE_VALUES];
+    seedRandom(cook->id);
+    pthread_barrier_wait(&startBarrier);
+    for (int step = 0; step < cook->steps; ++step) {
+        fillRandomBelow(recipe, RECIPE_VALUES, 10);
+        cook->checksum += recipe[step % RECIPE_VALUES];
+    }
+    return NULL;
+}
+
+// returns nanoseconds per drawn value, wall clock over all cooks
+double runBench(int cookCount, void *(*body)(void *)) {
+    BenchCook *cooks = calloc(cookCount, sizeof(BenchCook));
+    pthread_barrier_init(&startBarrier, NULL, cookCount + 1);
+    for (int i = 0; i < cookCount; ++i) {
+        cooks[i].id = i;
+        cooks[i].steps = STEPS_PER_RUN / cookCount;
+        pthread_create(&cooks[i].thread, NULL, body, &cooks[i]);
+    }
+    pthread_barrier_wait(&startBarrier);
+    long start = nowNs();
+    for (int i = 0; i < cookCount; ++i) {
+        pthread_join(cooks[i].thread, NULL);
+    }
+    long elapsed = nowNs() - start;
+    pthread_barrier_destroy(&startBarrier);
+    long values = (long)(STEPS_PER_RUN / cookCount) * cookCount * RECIPE_VALUES;
+    free(cooks);
+    return (double)elapsed / values;
+}
+
+int main(int argc, char *argv[]) {
+    int cookCounts[] = { 1, 10 };
+    setRandomSeed(1);
+    srand(1);
+
+    printf("%-8s %16s %16s %8s\n", "cooks", "rand() ns/value", "fast ns/value", "speedup");
+    for (size_t i = 0; i < sizeof(cookCounts) / sizeof(cookCounts[0]); ++i) {
+        double global = runBench(cookCounts[i], globalRandCook);
+        double fast = runBench(cookCounts[i], fastRandomCook);
+        printf("%-8d %16.2f %16.2f %7.1fx\n", cookCounts[i], global, fast, global / fast);
+    }
+    return 0;
+}
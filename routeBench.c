@@ -0,0 +1,83 @@
+// routeBench.c
+// courier distance per order for bags of 4 (time is distance / speed):
+//   fifo         bags in bake order, stops in bake order
+//   fifo routed  bags in bake order, stops ordered by planRoute
+//   dispatcher   oldest order plus its nearest neighbours, stops ordered by planRoute
+// meals are baked in a stream, couriers take a bag whenever `ready` of them wait
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dispatcher.h"
+#include "fastRandom.h"
+
+#define BAG_SIZE 4
+
+double fifoTour(Order **bag, int count) {
+    double length = 0.0;
+    int x = 0, y = 0;
+    for (int i = 0; i < count; ++i) {
+        length += stopDistance(x, y, bag[i]);
+        x = bag[i]->customerX;
+        y = bag[i]->customerY;
+    }
+    return length + hypot(x, y);
+}
+
+// average distance per order for one strategy, 0 fifo, 1 fifo routed, 2 dispatcher
+double runStrategy(Order *orders, int count, int ready, int strategy) {
+    Dispatcher dispatcher;
+    initDispatcher(&dispatcher);
+    Order *bag[BAG_SIZE];
+    double total = 0.0;
+    int next = 0, waiting = 0, delivered = 0;
+    while (delivered < count) {
+        while (next < count && waiting < ready) { // the oven keeps baking while couriers are out
+            if (strategy == 2) addReadyOrder(&dispatcher, &orders[next]);
+            next++;
+            waiting++;
+        }
+        int taken;
+        if (strategy == 2) {
+            taken = tryTakeBag(&dispatcher, bag, BAG_SIZE);
+        } else {
+            taken = 0;
+            for (int i = next - waiting; taken < BAG_SIZE && i < next; ++i) {
+                bag[taken++] = &orders[i];
+            }
+        }
+        total += (strategy == 0) ? fifoTour(bag, taken) : planRoute(bag, taken);
+        waiting -= taken;
+        delivered += taken;
+    }
+    destroyDispatcher(&dispatcher);
+    return total / count;
+}
+
+int main(int argc, char *argv[]) {
+    int count = (argc >= 2) ? atoi(argv[1]) : 100000;
+    int p = (argc == 4) ? atoi(argv[2]) : 15, q = (argc == 4) ? atoi(argv[3]) : 15;
+    int readyCounts[] = { 4, 16, 64 };
+    if (count <= 0 || p <= 0 || q <= 0 || argc == 3 || argc > 4) {
+        printf("Wrong Argument, please enter proper arguments: [orders(optional)] [p q(optional)]\n");
+        exit(1);
+    }
+    setRandomSeed(1);
+    Order *orders = calloc(count, sizeof(Order));
+    for (int i = 0; i < count; ++i) { // same spread as clientGenerator
+        orders[i].orderId = i + 1;
+        orders[i].customerX = randomBelow(2 * p + 1) - p;
+        orders[i].customerY = randomBelow(2 * q + 1) - q;
+        orders[i].dueUs = i; // the dispatcher takes the earliest due first, arrival order here
+    }
+
+    printf("%d orders on [-%d,%d]x[-%d,%d], bags of %d, distance per order\n", count, p, p, q, q, BAG_SIZE);
+    printf("%-8s %10s %13s %11s %8s\n", "ready", "fifo", "fifo routed", "dispatcher", "saving");
+    for (size_t i = 0; i < sizeof(readyCounts) / sizeof(readyCounts[0]); ++i) {
+        double fifo = runStrategy(orders, count, readyCounts[i], 0);
+        double routed = runStrategy(orders, count, readyCounts[i], 1);
+        double dispatched = runStrategy(orders, count, readyCounts[i], 2);
+        printf("%-8d %10.2f %13.2f %11.2f %7.1f%%\n", readyCounts[i], fifo, routed, dispatched, 100.0 * (1.0 - dispatched / fifo));
+    }
+    free(orders);
+    return 0;
+}
@@ -0,0 +1,128 @@
+// schedulerBench.c
+// orders/s for a growing worker pool. shared is the old cook loop: every worker takes
+// one mutex around a blocking dequeue on one OrderQueue. stealing is WorkScheduler with
+// per worker deques, orders are submitted in client batches by affinity
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "orderQueue.h"
+#include "workScheduler.h"
+
+#define BENCH_ORDERS 400000
+#define BENCH_CLIENTS 64
+#define BENCH_BATCH 16
+#define WORK_PER_ORDER 2000 // loop iterations standing in for preparation
+
+typedef struct {
+    int id;
+    unsigned long checksum;
+    pthread_t thread;
+} BenchWorker;
+
+OrderQueue sharedQueue;
+pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+WorkScheduler scheduler;
+Order *orders;
+int stealing;
+atomic_int doneOrders;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+unsigned long prepare(Order *order) {
+    unsigned long x = order->orderId;
+    for (int i = 0; i < WORK_PER_ORDER; ++i) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    return x;
+}
+
+// an order with id -1 tells a worker to stop
+void *benchWorker(void *arg) {
+    BenchWorker *worker = (BenchWorker *)arg;
+    while (1) {
+        Order *order;
+        if (stealing) {
+            order = takeWork(&scheduler, worker->id);
+        } else {
+            pthread_mutex_lock(&sharedLock);
+            order = dequeue(&sharedQueue);
+            pthread_mutex_unlock(&sharedLock);
+        }
+        if (order->orderId < 0) break;
+        worker->checksum += prepare(order);
+        atomic_fetch_add(&doneOrders, 1);
+    }
+    return NULL;
+}
+
+void submit(Order **batch, int count, int client) {
+    if (stealing) submitWork(&scheduler, client, batch, count);
+    else enqueueBatch(&sharedQueue, batch, count);
+}
+
+// returns orders per second
+double runBench(int workerCount) {
+    BenchWorker *workers = calloc(workerCount, sizeof(BenchWorker));
+    Order *stops = calloc(workerCount, sizeof(Order));
+    atomic_store(&doneOrders, 0);
+    if (stealing) initScheduler(&scheduler, workerCount);
+    for (int i = 0; i < workerCount; ++i) {
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, benchWorker, &workers[i]);
+    }
+
+    long start = nowNs();
+    for (int i = 0; i < BENCH_ORDERS; i += BENCH_BATCH) {
+        Order *batch[BENCH_BATCH];
+        for (int j = 0; j < BENCH_BATCH; ++j) {
+            batch[j] = &orders[i + j];
+        }
+        submit(batch, BENCH_BATCH, (i / BENCH_BATCH) % BENCH_CLIENTS);
+        while (i - atomic_load(&doneOrders) > ORDER_QUEUE_CAPACITY / 2) {
+            sched_yield(); // keep the shared ring from filling up
+        }
+    }
+    while (atomic_load(&doneOrders) < BENCH_ORDERS) {
+        sched_yield();
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+
+    for (int i = 0; i < workerCount; ++i) {
+        Order *stop = &stops[i];
+        stop->orderId = -1;
+        submit(&stop, 1, i);
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    if (stealing) destroyScheduler(&scheduler);
+    free(stops);
+    free(workers);
+    return BENCH_ORDERS / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    int workerCounts[] = { 1, 2, 4, 8, 16, 32 };
+    orders = calloc(BENCH_ORDERS, sizeof(Order));
+    for (int i = 0; i < BENCH_ORDERS; ++i) {
+        orders[i].orderId = i;
+    }
+    initQueue(&sharedQueue);
+
+    printf("%-8s %16s %16s %8s\n", "workers", "shared orders/s", "stealing orders/s", "speedup");
+    for (size_t i = 0; i < sizeof(workerCounts) / sizeof(workerCounts[0]); ++i) {
+        stealing = 0;
+        double shared = runBench(workerCounts[i]);
+        stealing = 1;
+        double stolen = runBench(workerCounts[i]);
+        printf("%-8d %16.0f %16.0f %7.2fx\n", workerCounts[i], shared, stolen, stolen / shared);
+    }
+    free(orders);
+    return 0;
+}
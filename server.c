@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // accept4
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -11,179 +12,347 @@
 #include <netdb.h> 
 #include <math.h> 
 #include <time.h> 
-
-
-#define MAX_COOKS 10
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <limits.h>
+#include "order.h"
+#include "workScheduler.h"
+#include "dispatcher.h"
+#include "orderPool.h"
+#include "complexMatrix.h"
+#include "fastRandom.h"
+#include "orderIndex.h"
+#include "oven.h"
+#include "simulation.h"
+#include "eventLog.h"
+#include "latencyHistogram.h"
+#include "adminServer.h"
+#include "session.h"
+#include "workerPool.h"
+#include "orderJournal.h"
+
+
+#define MAX_COOKS 64
 #define MAX_DELIVERY 1000
-#define MAX_OVEN_APARATUS 3
-#define MAX_OVEN_CAPACITY 6
 #define MAX_DELIVERY_BAG_CAPACITY 4
-#define BUFFER_SIZE 1024
-
-typedef struct Order {
-    struct Order *next;
-    int orderId;
-    int customerX, customerY; 
-    int orderDistanceConstanst; 
-    char customerLocation[BUFFER_SIZE];
-    char status[BUFFER_SIZE]; 
-} Order;
-
+#define MAX_FRONTEND_WORKERS 16
+#define DEFAULT_FRONTEND_WORKERS 2
+_Static_assert(MAX_COOKS + MAX_FRONTEND_WORKERS <= RANDOM_RESERVED_STREAMS, "cooks and front ends seed their own random streams");
+_Static_assert(MAX_COOKS + MAX_DELIVERY + MAX_FRONTEND_WORKERS + 64 <= MAX_LOG_RINGS, "every worker logs to its own ring, with room for helper threads");
+#define MAX_EPOLL_EVENTS 64
+#define CONNECTION_BUFFER_SIZE 16384
+#define MAX_REPLY_LINE 64
+#define MAX_BATCH_ORDERS 512
+#define MAX_BATCH_REPLY (MAX_BATCH_ORDERS * 12 + MAX_REPLY_LINE) // "R <seq>" plus one " <orderId>" per order
+#define MAX_MENU_ITEMS 32
+#define DEFAULT_COOK_GFLOPS 1.0 // simulated cook speed unless PIDESHOP_COOK_GFLOPS says otherwise
+#define STAFFING_TICK_MS 200
+#define STAFFING_DRAIN_SECONDS 2.0 // a backlog should be gone this long after the pool grew for it
+#define STAFFING_SHRINK_TICKS 15 // three seconds of surplus before one worker retires
+#define STAFFING_SMOOTHING 0.3 // weight of the newest tick in the rate averages
+#define DEFAULT_PROMISE_SLACK_MS 3000 // on top of the estimate, PIDESHOP_PROMISE_SLACK_MS overrides it
+#define MAX_QUOTE_MS 120000 // no order is quoted more, which also bounds how long it can be passed over
+#define ESTIMATE_SMOOTHING 8 // a new measurement moves an estimate by 1/8 of the difference
+#define WORKER_STOP_WAIT_MS 2000 // shutdown does not wait longer for a big recipe or a long route
+#define DEFAULT_JOURNAL "orders.journal" // PIDESHOP_JOURNAL overrides it, an empty value turns the journal off
+#define DEFAULT_JOURNAL_MAX_MB 256 // compacted each time it grew this much, PIDESHOP_JOURNAL_MAX_MB overrides it, 0 only at restart
+
+// wire formats, picked from the first byte a client sends
+#define PROTOCOL_UNKNOWN 0
+#define PROTOCOL_ONESHOT 1 // old "x-y-total" or "cancelOrder", one message per connection
+#define PROTOCOL_FRAMED 2 // newline framed "O <seq> <x> <y> <total>" lines on a kept open connection
+
+// stage boundary where a cook or courier found an order cancelled
+#define CANCEL_IN_QUEUE 0
+#define CANCEL_AFTER_PREPARATION 1
+#define CANCEL_AFTER_OVEN 2
+#define CANCEL_AT_PICKUP 3
+#define CANCEL_ON_THE_ROAD 4
+#define CANCEL_POINTS 5
+
+// every menu item is prepared as the pseudo-inverse of a rows x cols matrix,
+// so kitchen time grows with the size of the recipe
 typedef struct {
-    Order *head;
-    Order *tail;
-    pthread_mutex_t queueLock;
-    pthread_cond_t queueCond;
-} OrderQueue;
+    char name[32];
+    int rows;
+    int cols;
+} MenuItem;
 
 typedef struct {
     int id;
-    pthread_t thread; 
+    ComplexMatrix recipe; // reused between orders, resized per menu item
+    ComplexMatrix recipeInverse;
+    MatrixWorkspace workspace; // pseudoInverse intermediates, sized by the largest recipe so far
+    long busyNs; // preparing or waiting for an oven slot, since the server started
 } Cook;
 
 typedef struct {
     Order *orders[MAX_DELIVERY_BAG_CAPACITY];
     int id; 
     int speed;
-    int deliveryScore; 
     int orderCount; 
-    pthread_t thread;
+    long busyTotalNs; // on the road, shop to shop, since the server started
 } DeliveryPerson;
 
+// one accepted socket, owned by a front end worker or a clientHandler thread
 typedef struct {
-    int capacity;
-    int mealsInside;
-    pthread_mutex_t placeLock;
-    pthread_mutex_t removeLock;
-} Oven;
+    int fd;
+    int protocol;
+    int closeAfterWrite;
+    int inLen;
+    int outLen;
+    int outSent;
+    uint64_t ackMark; // journal sequence the buffered replies confirm, 0 when they confirm nothing
+    Session *session; // framed connections, opened by the first order
+    char in[CONNECTION_BUFFER_SIZE];
+    char out[CONNECTION_BUFFER_SIZE];
+} Connection;
+
+// one elastic stage, the staffing thread sizes its pool from the stage's backlog and rates
+typedef struct {
+    WorkerPool *pool;
+    double arrivalRate; // orders per second reaching the stage
+    double serviceRate; // orders per second one busy worker gets through, 0 until measured
+    long lastArrivals;
+    long lastDone;
+    long lastBusyNs;
+    int surplusTicks;
+} Staffing;
+
+// epoll loop with its own SO_REUSEPORT listen socket, the kernel spreads accepts over workers
+typedef struct {
+    int id;
+    int listenSocket;
+    int epollFd;
+    pthread_t thread;
+} FrontEndWorker;
 
 typedef struct {
     int port;
-    int cookPoolSize;
+    int minCooks;
+    int cookPoolSize; // the most cooks the pool may grow to
+    int minDelivery;
     int deliveryPoolSize;
     int speed;
     int serverSocket;
-    int numCooks;
-    int numDelivery;
-    Cook cooks[MAX_COOKS];
-    DeliveryPerson delivery[MAX_DELIVERY];
+    int frontEndPoolSize; // 0 = old thread per connection model
+    Cook *cooks; // cookPoolSize of them, only the pool's first poolSize() work
+    DeliveryPerson *delivery;
+    WorkerPool cookPool;
+    WorkerPool deliveryPool;
+    Staffing cookStaffing;
+    Staffing deliveryStaffing;
     pthread_t managerThread;
-    pthread_mutex_t logLock;
-    pthread_mutex_t ovenLock;
-    pthread_mutex_t deliveryBagLock;
-    Oven ovens[MAX_OVEN_APARATUS];
-    OrderQueue orderQueue;
-    OrderQueue ovenQueue;
-    OrderQueue deliveryQueue;
-    FILE *logFile;
+    OvenManager ovens;
+    FrontEndWorker frontEnds[MAX_FRONTEND_WORKERS];
+    WorkScheduler kitchen; // orders waiting for a cook, one deque per cook
+    Dispatcher dispatcher; // baked orders waiting for a delivery person
+    OrderIndex orderIndex; // every order from creation until it is released
+    SessionTable sessions; // one per client run, the order counts and reports live here
+    MenuItem menu[MAX_MENU_ITEMS];
+    int menuSize;
 } PideShopServer;
  
-typedef struct {
-    double real;
-    double imag;
-} Complex;
-
-Complex complex_conj(Complex a) {
-    Complex result;
-    result.real = a.real;
-    result.imag = -a.imag;
-    return result;
-}
-
 // thread functions
 void *cookThread(void *arg);
 void *deliveryThread(void *arg);
 void *clientHandler(void *arg);
 void *managerHandler(void *arg);
+void *frontEndThread(void *arg);
+void *staffingThread(void *arg);
 
 // initilise structs and queue
 void initCooks(PideShopServer *server);
 void initDelivery(PideShopServer *server);
-void initServer(PideShopServer *server, int port, int cookPoolSize, int deliveryPoolSize, int speed);
-void initQueue(OrderQueue *queue);
-void startServer();
-void returnTimeOfMatrix();
-
-void enqueue(OrderQueue *queue, Order *order);
-Order *dequeue(OrderQueue *queue);
-void printBestDeliveryPerson(PideShopServer *server);
+void initServer(PideShopServer *server, int port, int minCooks, int cookPoolSize, int minDelivery, int deliveryPoolSize, int speed);
+void parsePoolSize(const char *arg, int max, const char *name, int *min, int *size);
+int wantedWorkers(Staffing *staff, long arrivals, long done, long busyNs, size_t backlog, double seconds);
+void resizeCooks(PideShopServer *server, int wanted);
+void resizeDelivery(PideShopServer *server, int wanted);
+void wakeKitchen(void *ctx);
+void wakeDelivery(void *ctx);
+void returnTimeOfMatrix(Cook *cook, int menuItem);
+void loadMenu(PideShopServer *server, const char *path);
+void simulateShop(int argc, char *argv[]);
+int openListenSocket(const char *ip, int port, int reusePort);
+void startFrontEnds(PideShopServer *server, const char *ip);
+int createOrders(const int *locations, int count, int menuItem, Session *session, int *orderIds);
+Session *admitToSession(Connection *conn, int total, int count);
+int handleOrderMessage(char *message, Connection *conn, char *response, size_t responseSize);
+int handleFramedMessage(char *line, Connection *conn, char *reply, size_t replySize);
+int handleSupportMessage(char tag, char *line, unsigned int seq, char *reply, size_t replySize);
+int handleBatchMessage(char *line, unsigned int seq, Connection *conn, char *reply, size_t replySize);
+int processInput(Connection *conn);
+void acceptConnections(FrontEndWorker *worker);
+int readConnection(FrontEndWorker *worker, Connection *conn);
+void serviceConnection(FrontEndWorker *worker, Connection *conn);
+void closeConnection(FrontEndWorker *worker, Connection *conn);
+
+void retireOrder(Order *order);
+void printBestDeliveryPerson(PideShopServer *server, Session *session);
+void printCancelReport();
+void printLatencyReport(int endOfSpell);
+void restartLatencyReport();
+void printSessionLatency(Session *session);
+void *statsThread(void *arg);
+void writeMetrics(MetricsText *out, void *ctx);
+void sampleMetrics(void *ctx);
+void addBusyTime(long *busyNs, long ns);
+void ovenBaked(Order *order, int slot, void *ctx);
+long nowNs();
+long travel(double distance);
+void dropCancelledOrder(Order *order, int point, const char *worker, int workerId);
+void quoteOrders(Order **orders, int count);
+void recoverOrders(const char *path);
+void journalCancel(int orderId);
+int deliveredLate(const Order *order);
+void updateEstimate(long *estimateNs, long ns);
 void closeServer(PideShopServer *server);  
 
 // global variables
 PideShopServer server;
 pthread_t managerThread;
-int totalOrdersPlaced = 0;
-int totalOrdersCompleted = 0; 
-pthread_mutex_t countLock;
-pthread_mutex_t logMutex; 
-pthread_mutex_t cancelOrderMutex;
-
-char logText[BUFFER_SIZE];
-int orderState = -1, orderCtrl = -1; // -3 canceled orders, -2 newStart, -1 doesnt start , 0 start , 1 finished , 2 stuck
-
-void logMessage(const char *message) {
-    pthread_mutex_lock(&server.logLock);
-    fprintf(server.logFile, "%s", message);
-    fflush(server.logFile);
-    logText[0] = '\0'; 
-    pthread_mutex_unlock(&server.logLock);
+Session *legacySession; // one shot messages come on a connection each, they share this session
+pthread_mutex_t legacyLock = PTHREAD_MUTEX_INITIALIZER;
+atomic_int cancelledAt[CANCEL_POINTS]; // dropped orders per stage, reported when a session ends
+StageLatencies spellStart; // shop wide stage histograms as they were when the shop was last idle
+StageLatencies latencyReport;
+pthread_mutex_t reportLock = PTHREAD_MUTEX_INITIALIZER; // manager and SIGUSR1 share the two above
+// lifetime counters for the admin endpoint, sessions count their own orders
+atomic_long ordersReceived;
+atomic_long ordersDelivered;
+atomic_long ordersCancelled;
+atomic_long ordersPrepared; // the staffing thread's cook and courier service rates
+atomic_long ordersBaked;
+atomic_long ordersLate;
+// smoothed measurements the quotes are made from, written by cooks and couriers with relaxed stores
+long prepEstimateNs[MAX_MENU_ITEMS];
+long prepMeanNs;
+long deliveryMeanNs; // courier time per order, bag routes divided over their stops
+long promiseSlackNs;
+long serverStartNs;
+RateWindow receivedRate; // only the admin thread touches the windows
+RateWindow deliveredRate;
+
+int orderCtrl = -1;
+
+long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
 }
 
-void handleSignal(int signum) {
-    logMessage("Server shutting down...");
-    closeServer(&server);
-    exit(0);
+// a courier covers server.speed units of distance per second
+long travel(double distance) {
+    long ns = (long)(distance / server.speed * 1e9);
+    struct timespec ts = { ns / 1000000000L, ns % 1000000000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+    return ns;
 }
+
 int main(int argc, char *argv[]) {
 
-    if (argc != 6) {
-        printf("Wrong Argument, please enter proper arguments: [ip] [portnumber] [CookthreadPoolSize] [DeliveryPoolSize] [k] \n");
+    if (argc >= 2 && strcmp(argv[1], "--simulate") == 0) {
+        simulateShop(argc, argv);
+        return 0;
+    }
+    if (argc < 6 || argc > 8) {
+        printf("Wrong Argument, please enter proper arguments: [ip] [portnumber] [CookthreadPoolSize] [DeliveryPoolSize] [k] [FrontEndThreads(optional, 0 = thread per connection)] [menuFile(optional)] \n");
+        printf("a pool size of min-max, e.g. 2-16, lets the pool grow and shrink with the load\n");
+        printf("or: --simulate [traceFile or orderCount] [CookthreadPoolSize] [DeliveryPoolSize] [k] [menuFile(optional)] \n");
         exit(1);
     } 
  
     char *ip = argv[1];
     int port = atoi(argv[2]);
-    int cookPoolSize = atoi(argv[3]);
-    int deliveryPoolSize = atoi(argv[4]);
+    int minCooks, cookPoolSize, minDelivery, deliveryPoolSize;
+    parsePoolSize(argv[3], MAX_COOKS, "CookthreadPoolSize", &minCooks, &cookPoolSize);
+    parsePoolSize(argv[4], MAX_DELIVERY, "DeliveryPoolSize", &minDelivery, &deliveryPoolSize);
     int speed = atoi(argv[5]);
-
-    initServer(&server, port, cookPoolSize, deliveryPoolSize, speed);
-
-    signal(SIGINT, handleSignal);
-    signal(SIGTERM, handleSignal);
- 
-
-    server.serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server.serverSocket == -1) {
-        perror("Socket creation failed");
+    if (speed <= 0) {
+        printf("k (courier speed) must be positive\n");
         exit(1);
     }
-
-    pthread_mutex_init(&countLock, NULL); 
-    pthread_mutex_init(&logMutex, NULL);
-    pthread_mutex_init(&cancelOrderMutex, NULL);
-    
-
-    struct sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    serverAddr.sin_addr.s_addr = inet_addr(ip); // spesific ip number can be use
-    //serverAddr.sin_addr.s_addr = INADDR_ANY; // any ip number can be use
-
-    if (bind(server.serverSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) == -1) {
-        perror("Bind failed");
-        close(server.serverSocket);
+    int frontEndPoolSize = (argc >= 7) ? atoi(argv[6]) : DEFAULT_FRONTEND_WORKERS;
+    if (frontEndPoolSize < 0 || frontEndPoolSize > MAX_FRONTEND_WORKERS) {
+        printf("FrontEndThreads must be between 0 and %d\n", MAX_FRONTEND_WORKERS);
         exit(1);
     }
 
-    if (listen(server.serverSocket, 10) == -1) {
-        perror("Listen failed");
-        close(server.serverSocket);
+    loadMenu(&server, (argc == 8) ? argv[7] : NULL);
+    // SIGUSR1 asks for the stage latencies so far, SIGINT and SIGTERM shut down. every thread
+    // inherits the blocked mask, statsThread picks them up with sigwait, so the shutdown runs
+    // on an ordinary thread and may take locks and join
+    sigset_t statsSignal;
+    sigemptyset(&statsSignal);
+    sigaddset(&statsSignal, SIGUSR1);
+    sigaddset(&statsSignal, SIGINT);
+    sigaddset(&statsSignal, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &statsSignal, NULL);
+    // every cook and front end draws from its own stream of this seed, set PIDESHOP_SEED to replay a run
+    const char *seed = getenv("PIDESHOP_SEED");
+    setRandomSeed(seed != NULL ? strtoull(seed, NULL, 10) : (uint64_t)time(NULL));
+    const char *slack = getenv("PIDESHOP_PROMISE_SLACK_MS");
+    promiseSlackNs = (slack != NULL ? atol(slack) : DEFAULT_PROMISE_SLACK_MS) * 1000000L;
+    // big recipes split their rows over helper threads, one core is left to the cooks
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1 && startMatrixPool(cpus - 1) == -1) {
+        perror("Matrix thread creation failed");
         exit(1);
     }
+    initServer(&server, port, minCooks, cookPoolSize, minDelivery, deliveryPoolSize, speed);
+    server.frontEndPoolSize = frontEndPoolSize;
+    const char *journal = getenv("PIDESHOP_JOURNAL");
+    if (journal == NULL) journal = DEFAULT_JOURNAL;
+    const char *journalMaxMb = getenv("PIDESHOP_JOURNAL_MAX_MB");
+    setJournalLimit((journalMaxMb != NULL ? atol(journalMaxMb) : DEFAULT_JOURNAL_MAX_MB) * 1024L * 1024L);
+    if (journal[0] != '\0') recoverOrders(journal); // before any client can place an order
+
+    signal(SIGPIPE, SIG_IGN); // client may close before reading the reply
+
+    if (server.frontEndPoolSize == 0) {
+        server.serverSocket = openListenSocket(ip, port, 0);
+    } else {
+        server.serverSocket = -1;
+    }
     
-    snprintf(logText, sizeof(logText), "Server listening on port %d\n", port);
-    logMessage(logText); 
+    logLine("Server listening on port %d, random seed %llu\n", port, (unsigned long long)randomSeed());
+
+    // Prometheus text on the admin port, port + 1 unless PIDESHOP_ADMIN_PORT says otherwise, 0 turns it off
+    const char *adminPort = getenv("PIDESHOP_ADMIN_PORT");
+    int metricsPort = (adminPort != NULL) ? atoi(adminPort) : port + 1;
+    serverStartNs = nowNs();
+    if (metricsPort > 0) {
+        if (startAdminServer(openListenSocket(ip, metricsPort, 0), writeMetrics, sampleMetrics, &server) == -1) {
+            perror("Admin thread creation failed");
+            closeServer(&server);
+            exit(1);
+        }
+        logLine("Metrics on port %d\n", metricsPort);
+    }
+
+    pthread_t stats;
+    if (pthread_create(&stats, NULL, statsThread, NULL) != 0) {
+        perror("Stats thread creation failed");
+        closeServer(&server);
+        exit(1);
+    }
+    pthread_detach(stats);
+
+    if (minCooks < cookPoolSize || minDelivery < deliveryPoolSize) {
+        pthread_t staffing;
+        if (pthread_create(&staffing, NULL, staffingThread, &server) != 0) {
+            perror("Staffing thread creation failed");
+            closeServer(&server);
+            exit(1);
+        }
+        pthread_detach(staffing);
+        logLine("Cooks %d to %d, delivery persons %d to %d\n", minCooks, cookPoolSize, minDelivery, deliveryPoolSize);
+    }
 
     // join manager thread
     if(pthread_create(&managerThread, NULL, managerHandler, &managerThread) != 0){
@@ -193,11 +362,17 @@ int main(int argc, char *argv[]) {
     }
  
     printf("PideShop active waiting for connection... \n");
-    while (1) { 
+    if (server.frontEndPoolSize > 0) {
+        startFrontEnds(&server, ip);
+        for (int i = 0; i < server.frontEndPoolSize; ++i) {
+            pthread_join(server.frontEnds[i].thread, NULL);
+        }
+    }
+    while (server.frontEndPoolSize == 0) { 
         int clientSocket = accept(server.serverSocket, NULL, NULL);
         if (clientSocket == -1) { 
-            snprintf(logText, sizeof(logText), "Socket Accept failed\n");
-            logMessage(logText); 
+            if (errno == EBADF || errno == EINVAL) break; // closed by the shutdown
+            logLine("Socket Accept failed\n");
             continue;
         }
         pthread_t clientThread; 
@@ -215,414 +390,1283 @@ int main(int argc, char *argv[]) {
     return 0;
 } 
 
-void initQueue(OrderQueue *queue) {
-    queue->head = NULL;
-    queue->tail = NULL; 
-    pthread_mutex_init(&queue->queueLock, NULL);
-    pthread_cond_init(&queue->queueCond, NULL);
+// "n" is a fixed pool, "min-max" an elastic one. exits on a size out of 1..max
+void parsePoolSize(const char *arg, int max, const char *name, int *min, int *size) {
+    char *end;
+    *min = (int)strtol(arg, &end, 10);
+    *size = (*end == '-') ? (int)strtol(end + 1, &end, 10) : *min;
+    if (*end != '\0' || *min <= 0 || *size < *min || *size > max) {
+        printf("%s must be 1 to %d, or min-max within that\n", name, max);
+        exit(1);
+    }
 }
 
-void enqueue(OrderQueue *queue, Order *order) {
-    order->next = NULL;
-    pthread_mutex_lock(&queue->queueLock);
-    if (queue->tail == NULL) {
-        queue->head = order;
-        queue->tail = order;
-    } else {
-        queue->tail->next = order;
-        queue->tail = order;
+// exits on failure, reusePort lets every front end worker bind the same address
+int openListenSocket(const char *ip, int port, int reusePort) {
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket == -1) {
+        perror("Socket creation failed");
+        exit(1);
+    }
+
+    int enable = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (reusePort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        perror("SO_REUSEPORT failed");
+        close(listenSocket);
+        exit(1);
+    }
+
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = inet_addr(ip); // spesific ip number can be use
+    //serverAddr.sin_addr.s_addr = INADDR_ANY; // any ip number can be use
+
+    if (bind(listenSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) == -1) {
+        perror("Bind failed");
+        close(listenSocket);
+        exit(1);
+    }
+
+    if (listen(listenSocket, reusePort ? SOMAXCONN : 10) == -1) {
+        perror("Listen failed");
+        close(listenSocket);
+        exit(1);
+    }
+    return listenSocket;
+}
+
+void startFrontEnds(PideShopServer *server, const char *ip) {
+    for (int i = 0; i < server->frontEndPoolSize; ++i) {
+        FrontEndWorker *worker = &server->frontEnds[i];
+        worker->id = i;
+        worker->listenSocket = openListenSocket(ip, server->port, 1);
+        fcntl(worker->listenSocket, F_SETFL, fcntl(worker->listenSocket, F_GETFL) | O_NONBLOCK);
+
+        worker->epollFd = epoll_create1(0);
+        if (worker->epollFd == -1) {
+            perror("epoll_create1 failed");
+            closeServer(server);
+            exit(1);
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = NULL; // NULL marks the listen socket
+        epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->listenSocket, &event);
+
+        if (pthread_create(&worker->thread, NULL, frontEndThread, worker) != 0) {
+            perror("Front end thread creation failed");
+            closeServer(server);
+            exit(1);
+        }
     }
-    pthread_cond_signal(&queue->queueCond);
-    pthread_mutex_unlock(&queue->queueLock);
 }
 
-Order *dequeue(OrderQueue *queue) {
-    pthread_mutex_lock(&queue->queueLock);
-    while (queue->head == NULL) {  
-        if(orderState == 2) break;
-        pthread_cond_wait(&queue->queueCond, &queue->queueLock);  
+// takes a delivered or dropped order out of the index and gives it back to the pool
+void retireOrder(Order *order) {
+    unindexOrder(&server.orderIndex, order->orderId);
+    releaseOrder(order);
+}
+
+// "name rows cols" per line, # starts a comment. without a file the shop sells the
+// classic 30x40 pide plus a mid size and a catering size recipe
+void loadMenu(PideShopServer *server, const char *path) {
+    MenuItem defaults[] = { { "pide", 30, 40 }, { "lahmacun", 96, 128 }, { "catering", 512, 512 } };
+    server->menuSize = 0;
+    if (path == NULL) {
+        memcpy(server->menu, defaults, sizeof(defaults));
+        server->menuSize = sizeof(defaults) / sizeof(defaults[0]);
+        return;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror("Failed to open menu file");
+        exit(1);
     }
-    Order *order = queue->head;
-    queue->head = order->next;
-    if (queue->head == NULL) {
-        queue->tail = NULL;
+    char line[BUFFER_SIZE];
+    while (fgets(line, sizeof(line), file) != NULL && server->menuSize < MAX_MENU_ITEMS) {
+        MenuItem *item = &server->menu[server->menuSize];
+        if (line[0] == '#' || sscanf(line, "%31s %d %d", item->name, &item->rows, &item->cols) != 3) continue;
+        if (item->rows <= 0 || item->cols <= 0) {
+            printf("menu item %s needs a positive size\n", item->name);
+            exit(1);
+        }
+        server->menuSize++;
+    }
+    fclose(file);
+    if (server->menuSize == 0) {
+        printf("menu file %s has no items\n", path);
+        exit(1);
     }
-    pthread_mutex_unlock(&queue->queueLock);
-    return order;
 }
 
-void initServer(PideShopServer *server, int port, int cookPoolSize, int deliveryPoolSize, int speed) {
+// same shop in virtual time: a cook takes the menu item's pseudo-inverse flops at
+// PIDESHOP_COOK_GFLOPS to prepare it and the oven bakes it as long again. a number instead
+// of a trace file replays that many orders over a synthetic day from PIDESHOP_SEED
+void simulateShop(int argc, char *argv[]) {
+    if (argc < 6 || argc > 7) {
+        printf("Wrong Argument, please enter proper arguments: --simulate [traceFile or orderCount] [CookthreadPoolSize] [DeliveryPoolSize] [k] [menuFile(optional)] \n");
+        exit(1);
+    }
+    SimulationConfig config;
+    config.cooks = atoi(argv[3]);
+    config.couriers = atoi(argv[4]);
+    config.speed = atoi(argv[5]);
+    config.bagCapacity = MAX_DELIVERY_BAG_CAPACITY;
+    if (config.cooks <= 0 || config.cooks > MAX_COOKS || config.couriers <= 0 || config.couriers > MAX_DELIVERY || config.speed <= 0) {
+        printf("need 1 to %d cooks, 1 to %d delivery persons and a positive k\n", MAX_COOKS, MAX_DELIVERY);
+        exit(1);
+    }
+    loadMenu(&server, (argc == 7) ? argv[6] : NULL);
+    const char *gflops = getenv("PIDESHOP_COOK_GFLOPS");
+    double cookFlops = (gflops != NULL ? atof(gflops) : DEFAULT_COOK_GFLOPS) * 1e9;
+    if (cookFlops <= 0) {
+        printf("PIDESHOP_COOK_GFLOPS must be positive\n");
+        exit(1);
+    }
+    config.menuSize = server.menuSize;
+    for (int i = 0; i < server.menuSize; ++i) {
+        config.prepNs[i] = (long)(pseudoInverseFlops(server.menu[i].rows, server.menu[i].cols) / cookFlops * 1e9);
+    }
+    const char *slack = getenv("PIDESHOP_PROMISE_SLACK_MS");
+    config.promiseSlackNs = (slack != NULL ? atol(slack) : DEFAULT_PROMISE_SLACK_MS) * 1000000L;
+    config.maxQuoteNs = MAX_QUOTE_MS * 1000000L;
+    const char *seed = getenv("PIDESHOP_SEED");
+    setRandomSeed(seed != NULL ? strtoull(seed, NULL, 10) : 1);
+
+    TraceOrder *trace;
+    char *end;
+    long orders = strtol(argv[2], &end, 10);
+    int count = (*end == '\0' && orders > 0) ? syntheticTrace((int)orders, &trace) : loadTrace(argv[2], server.menuSize, &trace);
+    if (count == -1) {
+        perror("Failed to open trace file");
+        exit(1);
+    }
+    printf("random seed %llu, cooks at %.2f GFLOP/s\n", (unsigned long long)randomSeed(), cookFlops / 1e9);
+    runSimulation(&config, trace, count);
+    free(trace);
+}
+
+void initServer(PideShopServer *server, int port, int minCooks, int cookPoolSize, int minDelivery, int deliveryPoolSize, int speed) {
     server->port = port;
+    server->minCooks = minCooks;
     server->cookPoolSize = cookPoolSize;
+    server->minDelivery = minDelivery;
     server->deliveryPoolSize = deliveryPoolSize;
     server->speed = speed;
-    server->numCooks = 0;
-    server->numDelivery = 0;
     orderCtrl = -1;
-    pthread_mutex_init(&server->logLock, NULL);
-    pthread_mutex_init(&server->ovenLock, NULL);
-    pthread_mutex_init(&server->deliveryBagLock, NULL);
-    for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
-        server->ovens[i].capacity = MAX_OVEN_CAPACITY;
-        server->ovens[i].mealsInside = 0;
-        pthread_mutex_init(&server->ovens[i].placeLock, NULL);
-        pthread_mutex_init(&server->ovens[i].removeLock, NULL);
-    }
-    initQueue(&server->orderQueue);
-    initQueue(&server->ovenQueue);
-    initQueue(&server->deliveryQueue);
-    initCooks(server);
-    initDelivery(server);
-
-    server->logFile = fopen("server.log", "a");
-    if (server->logFile == NULL) {
+    // binary records, logDecoderExe turns them back into text
+    if (startLog("server.log") == -1) {
         perror("Failed to open log file");
         exit(1);
     }
+    initOvenManager(&server->ovens);
+    if (startOvenTimer(&server->ovens, ovenBaked, NULL) == -1) {
+        perror("Oven timer thread creation failed");
+        exit(1);
+    }
+    initScheduler(&server->kitchen, cookPoolSize);
+    initSessionTable(&server->sessions, &server->kitchen, minCooks, deliveryPoolSize);
+    initDispatcher(&server->dispatcher);
+    initOrderIndex(&server->orderIndex);
+    initCooks(server);
+    initDelivery(server);
 }
 
-void startServer(){ 
-    server.numCooks = 0;
-    server.numDelivery = 0;
-    orderCtrl = -1;
-    for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
-        server.ovens[i].capacity = MAX_OVEN_CAPACITY;
-        server.ovens[i].mealsInside = 0; 
-    }
-    initQueue(&server.orderQueue);
-    initQueue(&server.ovenQueue);
-    initQueue(&server.deliveryQueue);
-    initCooks(&server);
-    initDelivery(&server);
- 
-}
+// every cook up to the maximum gets its struct, the pool starts the first minCooks threads
 void initCooks(PideShopServer *server) {
+    server->cooks = (Cook *)calloc(server->cookPoolSize, sizeof(Cook));
+    void **args = (void **)malloc(sizeof(void *) * server->cookPoolSize);
+    if (server->cooks == NULL || args == NULL) {
+        perror("Failed to allocate cooks");
+        exit(1);
+    }
     for (int i = 0; i < server->cookPoolSize; ++i) {
         server->cooks[i].id = i; 
-        pthread_create(&server->cooks[i].thread, NULL, cookThread, &server->cooks[i]);
-        server->numCooks++;
+        initComplexMatrix(&server->cooks[i].recipe, 1, 1);
+        initComplexMatrix(&server->cooks[i].recipeInverse, 1, 1);
+        if (initMatrixWorkspace(&server->cooks[i].workspace) == -1) {
+            perror("Failed to allocate cooks");
+            exit(1);
+        }
+        args[i] = &server->cooks[i];
     }
+    initWorkerPool(&server->cookPool, server->minCooks, server->cookPoolSize, cookThread, args);
+    resizeCooks(server, server->minCooks);
 }
 
 void initDelivery(PideShopServer *server) {
+    server->delivery = (DeliveryPerson *)calloc(server->deliveryPoolSize, sizeof(DeliveryPerson));
+    void **args = (void **)malloc(sizeof(void *) * server->deliveryPoolSize);
+    if (server->delivery == NULL || args == NULL) {
+        perror("Failed to allocate delivery persons");
+        exit(1);
+    }
     for (int i = 0; i < server->deliveryPoolSize; ++i) {
         server->delivery[i].id = i;
         server->delivery[i].speed = server->speed; 
-        server->delivery[i].deliveryScore = 0; // Initialize delivery score
-        server->delivery[i].orderCount = 0;
-        pthread_create(&server->delivery[i].thread, NULL, deliveryThread, &server->delivery[i]);
-        server->numDelivery++;
+        args[i] = &server->delivery[i];
     }
+    initWorkerPool(&server->deliveryPool, server->minDelivery, server->deliveryPoolSize, deliveryThread, args);
+    resizeDelivery(server, server->minDelivery);
 }
 
-void closeServer(PideShopServer *server) {
-    close(server->serverSocket);
-
-    // Stop cooks
-    for (int i = 0; i < server->cookPoolSize; ++i) {
-        pthread_cancel(server->cooks[i].thread);
+// new cooks are made active before they start, so their first takeWork does not send them away.
+// a retiring cook is flagged first, the smaller active count then wakes it to hand off its deque
+void resizeCooks(PideShopServer *server, int wanted) {
+    int size = poolSize(&server->cookPool);
+    while (size < wanted) {
+        setActiveWorkers(&server->kitchen, size + 1);
+        int grown = growPool(&server->cookPool);
+        if (grown == size) break;
+        size = grown;
     }
-
-    // Stop delivery personnel
-    for (int i = 0; i < server->deliveryPoolSize; ++i) {
-        pthread_cancel(server->delivery[i].thread);
+    while (size > wanted) {
+        int shrunk = shrinkPool(&server->cookPool);
+        if (shrunk == size) break;
+        size = shrunk;
     }
+    setActiveWorkers(&server->kitchen, size);
+    setKitchenShare(&server->sessions, size);
+}
 
-    pthread_mutex_destroy(&server->logLock);
-    pthread_mutex_destroy(&server->ovenLock);
-    pthread_mutex_destroy(&server->deliveryBagLock);
-    pthread_mutex_destroy(&cancelOrderMutex);
-    pthread_mutex_destroy(&countLock);
-    for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
-        pthread_mutex_destroy(&server->ovens[i].placeLock);
-        pthread_mutex_destroy(&server->ovens[i].removeLock);
+void resizeDelivery(PideShopServer *server, int wanted) {
+    int size = poolSize(&server->deliveryPool);
+    while (size < wanted) {
+        int grown = growPool(&server->deliveryPool);
+        if (grown == size) break;
+        size = grown;
     }
-    snprintf(logText, sizeof(logText), "Sever closed successfully \n");
-    logMessage(logText); 
-    
-    // Close the log file
-    if (server->logFile) {
-        fclose(server->logFile);
-        server->logFile = NULL;
+    int retired = 0;
+    while (size > wanted) {
+        int shrunk = shrinkPool(&server->deliveryPool);
+        if (shrunk == size) break;
+        size = shrunk;
+        retired = 1;
+    }
+    if (retired) wakeCouriers(&server->dispatcher);
+}
+
+void wakeKitchen(void *ctx) {
+    setActiveWorkers(&((PideShopServer *)ctx)->kitchen, 0);
+}
+
+void wakeDelivery(void *ctx) {
+    wakeCouriers(&((PideShopServer *)ctx)->dispatcher);
+}
+
+// once, from statsThread on a shutdown signal or from main on a startup failure
+void closeServer(PideShopServer *server) {
+    static atomic_int closing;
+    if (atomic_exchange(&closing, 1)) return;
+    if (server->serverSocket != -1) close(server->serverSocket);
+    for (int i = 0; i < server->frontEndPoolSize; ++i) {
+        close(server->frontEnds[i].listenSocket);
     }
+
+    // every worker leaves at its next wait for work, one still busy after the wait is left to exit
+    int leftRunning = stopPool(&server->cookPool, wakeKitchen, server, WORKER_STOP_WAIT_MS);
+    leftRunning += stopPool(&server->deliveryPool, wakeDelivery, server, WORKER_STOP_WAIT_MS);
+    stopOvenTimer(&server->ovens); // joined, nothing waits on the manager's lock when it goes
+    closeJournal(); // after the workers and the timer, their last records are on disk
+
+    // a cook left running may still wait for an oven, the process exit takes the manager then
+    if (leftRunning == 0) destroyOvenManager(&server->ovens);
+    logLine("Sever closed successfully \n");
+    stopLog(); // writes out what the rings still hold
 }
 
 void *cookThread(void *arg) {
     Cook *cook = (Cook *)arg;
+    seedRandom(cook->id);
     while (1) {
-        pthread_mutex_lock(&cancelOrderMutex);
-        if(orderState == -3) break;
-        pthread_mutex_lock(&server.ovenLock);
-        Order *order = dequeue(&server.orderQueue);
-        pthread_mutex_unlock(&server.ovenLock);
-        if (order != NULL) {
-            pthread_mutex_lock(&logMutex); 
-            snprintf(logText, sizeof(logText), "Cook %d: Preparing order %d\n", cook->id, order->orderId);
-            logMessage(logText); 
-            strcpy(order->status, "Preparing");
-            pthread_mutex_unlock(&logMutex);
-
-            returnTimeOfMatrix(); // calculated under the code below
-
-            pthread_mutex_lock(&logMutex); 
-            snprintf(logText, sizeof(logText), "Cook %d: Cooking order %d\n", cook->id, order->orderId);
-            logMessage(logText); 
-            strcpy(order->status, "Cooking");
-            pthread_mutex_unlock(&logMutex);
-
-            int placed = 0;
-            while (!placed) {
-                for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
-                    pthread_mutex_lock(&server.ovens[i].placeLock);
-                    if (server.ovens[i].mealsInside < server.ovens[i].capacity) {
-                        server.ovens[i].mealsInside++;
-                        pthread_mutex_lock(&logMutex);
-                        
-                        order->orderDistanceConstanst = (order->customerX * order->customerX + order->customerY * order->customerY) / 2;
-                        if(order->orderDistanceConstanst == 0) order->orderDistanceConstanst =1;
- 
-                        snprintf(logText, sizeof(logText), "Cook %d: Placed order %d in oven with aparatus %d\n", cook->id, order->orderId, i);
-                        logMessage(logText); 
-                        pthread_mutex_unlock(&logMutex);
-                        placed = 1;
-                        pthread_mutex_unlock(&server.ovens[i].placeLock);
-                        break;
-                    }
-                    pthread_mutex_unlock(&server.ovens[i].placeLock);
-                } 
-            }
-
-            returnTimeOfMatrix(); // cooking time takes half of preparation time
-
-            int removed = 0;
-            while (!removed) {
-                for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
-                    pthread_mutex_lock(&server.ovens[i].removeLock);
-                    if (server.ovens[i].mealsInside > 0) {
-                        server.ovens[i].mealsInside--;
-                        pthread_mutex_lock(&logMutex); 
-                        snprintf(logText, sizeof(logText), "Cook %d: Removed order %d from oven with aparatus%d\n", cook->id, order->orderId, i);
-                        logMessage(logText);
-                        
-                        strcpy(order->status, "Cooked");
-                        pthread_mutex_unlock(&logMutex);
-                        removed = 1;
-                        pthread_mutex_unlock(&server.ovens[i].removeLock);
-                        break;
-                    }
-                    pthread_mutex_unlock(&server.ovens[i].removeLock);
-                } 
+        Order *order = takeWork(&server.kitchen, cook->id); // own deque first, then steals
+        if (order == NULL) { // the pool shrank past this cook
+            if (leavePool(&server.cookPool, cook->id)) break;
+            continue;
+        }
+        leftKitchen(&server.sessions, sessionOf(&server.sessions, order->client)); // lets the next one of its session in
+        // every stage change fails once the order was cancelled, the cook drops it there
+        if (!advanceOrderStatus(order, ORDER_RECEIVED, ORDER_PREPARING)) {
+            dropCancelledOrder(order, CANCEL_IN_QUEUE, "Cook", cook->id);
+        } else {
+            stampOrder(order, STAMP_PREPARING);
+            logEvent(LOG_COOK_PREPARING, cook->id, order->orderId, 0, 0);
+
+            long prepStart = nowNs();
+            returnTimeOfMatrix(cook, order->menuItem); // calculated under the code below
+            long prepNs = nowNs() - prepStart;
+            addBusyTime(&cook->busyNs, prepNs);
+            updateEstimate(&prepEstimateNs[order->menuItem], prepNs);
+            updateEstimate(&prepMeanNs, prepNs);
+            atomic_fetch_add(&ordersPrepared, 1);
+
+            if (!advanceOrderStatus(order, ORDER_PREPARING, ORDER_COOKING)) {
+                dropCancelledOrder(order, CANCEL_AFTER_PREPARATION, "Cook", cook->id);
+                continue;
             }
-
-            enqueue(&server.ovenQueue, order);
+            stampOrder(order, STAMP_COOKING);
+            logEvent(LOG_COOK_COOKING, cook->id, order->orderId, 0, 0);
+
+            // the oven timer takes the meal out after as long as it took to prepare,
+            // this cook goes straight back to the order queue. the order may be delivered
+            // before we log, so its id is read first
+            int orderId = order->orderId;
+            long placeStart = nowNs();
+            int slot = bakeInOven(&server.ovens, order, placeStart - prepStart); // sleeps while the ovens are full
+            addBusyTime(&cook->busyNs, nowNs() - placeStart);
+            logEvent(LOG_COOK_PLACED, cook->id, orderId, ovenOfSlot(slot), 0);
         }
-        pthread_mutex_unlock(&cancelOrderMutex);
     }
     return NULL;
 }
 
+// oven timer thread, hands baked meals to the couriers
+void ovenBaked(Order *order, int slot, void *ctx) {
+    stampOrder(order, STAMP_REMOVED);
+    logEvent(LOG_OVEN_REMOVED, order->orderId, ovenOfSlot(slot), 0, 0);
+    if (!advanceOrderStatus(order, ORDER_COOKING, ORDER_COOKED)) {
+        dropCancelledOrder(order, CANCEL_AFTER_OVEN, "Oven", ovenOfSlot(slot));
+        return;
+    }
+    atomic_fetch_add(&ordersBaked, 1);
+    journalStage(order->orderId, JOURNAL_BAKED);
+    addReadyOrder(&server.dispatcher, order);
+}
+
+const char *cancelPoints[CANCEL_POINTS] = { "waiting in the queue", "after preparation", "after the oven", "at pickup", "on the road" };
+
+// a dropped order is finished as far as its session goes
+void dropCancelledOrder(Order *order, int point, const char *worker, int workerId) {
+    Session *session = sessionOf(&server.sessions, order->client);
+    logLine("%s %d: Dropped order %d, cancelled %s\n", worker, workerId, order->orderId, cancelPoints[point]);
+    atomic_fetch_add(&cancelledAt[point], 1);
+    atomic_fetch_add(&ordersCancelled, 1);
+    atomic_fetch_add(&session->cancelled, 1);
+    retireOrder(order);
+    finishSessionOrders(&server.sessions, session, 1);
+}
+
 void *deliveryThread(void *arg) {
     DeliveryPerson *deliveryPerson = (DeliveryPerson *)arg; 
     while (1) { 
-        //pthread_mutex_lock(&cancelOrderMutex);
-        if(orderState == -3) break;
-        pthread_mutex_lock(&server.deliveryBagLock);
-        
-        while (deliveryPerson->orderCount < MAX_DELIVERY_BAG_CAPACITY) {
-            pthread_mutex_lock(&countLock);
-            if(orderState == 2) {
-                orderState = 1;
-                break;
-            }
-            pthread_mutex_unlock(&countLock);
-            Order *order = dequeue(&server.ovenQueue);
-            if (order != NULL) {
-                deliveryPerson->orders[deliveryPerson->orderCount++] = order;
-                pthread_mutex_lock(&logMutex); 
-                snprintf(logText, sizeof(logText), "Delivery %d: Picked up order %d\n", deliveryPerson->id, order->orderId);
-                logMessage(logText);
-                pthread_mutex_unlock(&logMutex);
-
-                // Increment totalOrdersCompleted 
-                pthread_mutex_lock(&countLock); 
-                ++totalOrdersCompleted;
-                pthread_mutex_unlock(&countLock);
-
+        // the longest waiting meal and the ones closest to it, see dispatcher.c
+        Order *bag[MAX_DELIVERY_BAG_CAPACITY];
+        int picked = takeBag(&server.dispatcher, bag, MAX_DELIVERY_BAG_CAPACITY, &server.deliveryPool.retire[deliveryPerson->id]);
+        if (picked == 0) {
+            if (leavePool(&server.deliveryPool, deliveryPerson->id)) break;
+            continue;
+        }
+        for (int i = 0; i < picked; ++i) {
+            Order *order = bag[i];
+            if (readOrderStatus(order) == ORDER_CANCELLED) {
+                dropCancelledOrder(order, CANCEL_AT_PICKUP, "Delivery", deliveryPerson->id);
             } else {
-                break;
+                deliveryPerson->orders[deliveryPerson->orderCount++] = order;
+                stampOrder(order, STAMP_PICKED_UP);
+                logEvent(LOG_PICKED_UP, deliveryPerson->id, order->orderId, 0, 0);
             }
         }
  
         if (deliveryPerson->orderCount > 0) {
-            pthread_mutex_lock(&logMutex); 
-            snprintf(logText, sizeof(logText), "Delivery %d: Starting delivery with %d orders\n", deliveryPerson->id, deliveryPerson->orderCount);
-            logMessage(logText);
-            pthread_mutex_unlock(&logMutex);
+            double route = planRoute(deliveryPerson->orders, deliveryPerson->orderCount);
+            logEvent(LOG_ROUTE, deliveryPerson->id, deliveryPerson->orderCount, (int32_t)lround(route * 10), 0);
 
+            int x = 0, y = 0; // the shop
+            long start = nowNs();
             for (int i = 0; i < deliveryPerson->orderCount; ++i) {
                 Order *order = deliveryPerson->orders[i];
-                pthread_mutex_lock(&logMutex);
-                if(snprintf(logText, sizeof(logText), "Delivery %d: Delivering order %d to %s\n", deliveryPerson->id, order->orderId, order->customerLocation) < 0){
-                    printf("buffer problem with snprintf in clientHandler\n");
-                } 
-                
-                logMessage(logText);
-                strcpy(order->status, "Delivering");
-                pthread_mutex_unlock(&logMutex);
-
-                sleep(server.speed / order->orderDistanceConstanst); //  sleepTime = distance / speed
-
-                pthread_mutex_lock(&logMutex); 
-                snprintf(logText, sizeof(logText), "Delivery %d: Delivered order %d\n", deliveryPerson->id, order->orderId);
-                logMessage(logText);
-                strcpy(order->status, "Delivered");
-                pthread_mutex_unlock(&logMutex);
-
-                deliveryPerson->deliveryScore += 10; // Update delivery score for each successful delivery
-                free(order); // Clean up the order 
+                if (!advanceOrderStatus(order, ORDER_COOKED, ORDER_DELIVERING)) {
+                    dropCancelledOrder(order, CANCEL_ON_THE_ROAD, "Delivery", deliveryPerson->id);
+                    continue;
+                }
+                stampOrder(order, STAMP_DELIVERING);
+                journalStage(order->orderId, JOURNAL_DELIVERING);
+                logEvent(LOG_DELIVERING, deliveryPerson->id, order->orderId, order->customerX, order->customerY);
+                long road = travel(stopDistance(x, y, order)); //  travelTime = distance / speed
+                x = order->customerX;
+                y = order->customerY;
+
+                stampOrder(order, STAMP_DELIVERED);
+                // a driving order is past cancelling, the check keeps that rule in one place
+                if (!advanceOrderStatus(order, ORDER_DELIVERING, ORDER_DELIVERED)) {
+                    dropCancelledOrder(order, CANCEL_ON_THE_ROAD, "Delivery", deliveryPerson->id);
+                    continue;
+                }
+                logEvent(LOG_DELIVERED, deliveryPerson->id, order->orderId, 0, 0);
+                journalStage(order->orderId, JOURNAL_DELIVERED);
+                recordOrderStages(order);
+                atomic_fetch_add(&ordersDelivered, 1);
+                int late = deliveredLate(order);
+                if (late) atomic_fetch_add(&ordersLate, 1);
+
+                // the session may be reported and reused once its last order finishes, its stats come first
+                Session *session = sessionOf(&server.sessions, order->client);
+                recordSharedOrderStages(session->latencies, order);
+                session->courierDeliveries[deliveryPerson->id]++;
+                atomic_fetch_add(&session->roadNs, road);
+                if (late) atomic_fetch_add(&session->late, 1);
+                atomic_fetch_add(&session->delivered, 1);
+                retireOrder(order); // Clean up the order 
+                finishSessionOrders(&server.sessions, session, 1);
             }
+            travel(hypot(x, y)); // back to the shop
+            long routeNs = nowNs() - start;
+            addBusyTime(&deliveryPerson->busyTotalNs, routeNs);
+            updateEstimate(&deliveryMeanNs, routeNs / deliveryPerson->orderCount);
 
             deliveryPerson->orderCount = 0; // Reset order count after delivery
         }
- 
-
-        pthread_mutex_unlock(&server.deliveryBagLock); 
-        //pthread_mutex_unlock(&cancelOrderMutex);
     }
     return NULL;
 }
 
+// old model, one detached thread per accepted socket
 void *clientHandler(void *arg) {
-    pthread_mutex_lock(&countLock); 
-    if(orderState == -1) orderState = -2; 
-    pthread_mutex_unlock(&countLock);
+    Connection *conn = (Connection *)malloc(sizeof(Connection));
+    memset(conn, 0, offsetof(Connection, in));
+    conn->fd = (int)(intptr_t)arg;
+
+    while (!conn->closeAfterWrite) {
+        int bytesReceived = recv(conn->fd, conn->in + conn->inLen, sizeof(conn->in) - 1 - conn->inLen, 0);
+        if (bytesReceived <= 0) break;
+        conn->inLen += bytesReceived;
+        int failed = 0;
+        do { // drain every complete line before blocking in recv again
+            if (processInput(conn) == -1) {
+                failed = 1;
+                break;
+            }
+            if (conn->ackMark != 0) { // no reply before the orders it confirms are on disk
+                waitJournal(conn->ackMark);
+                conn->ackMark = 0;
+            }
+            if (conn->outLen > 0 && send(conn->fd, conn->out, conn->outLen, MSG_NOSIGNAL) == -1) {
+                failed = 1;
+                break;
+            }
+            int wrote = conn->outLen;
+            conn->outLen = 0;
+            if (wrote == 0 || conn->closeAfterWrite) break;
+        } while (1);
+        if (failed) break;
+    }
+
+    if (conn->session != NULL) closeSession(&server.sessions, conn->session);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+// allocates and queues count orders from x,y pairs in one pass, fills orderIds.
+// returns the number of orders placed
+// count orders already admitted to session, a refused order is finished right away
+int createOrders(const int *locations, int count, int menuItem, Session *session, int *orderIds) {
+    Order *orders[MAX_BATCH_ORDERS];
+    for (int i = 0; i < 2 * count; ++i) {
+        // out of delivery range, refused with the rest. no abs(), it is undefined for INT_MIN
+        if (locations[i] < -MAX_CUSTOMER_DISTANCE || locations[i] > MAX_CUSTOMER_DISTANCE) menuItem = -1;
+    }
+    if (menuItem < 0 || menuItem >= server.menuSize || allocOrders(orders, count) == -1) {
+        finishSessionOrders(&server.sessions, session, count);
+        return 0;
+    }
+
+    int firstId = reserveOrderIds(&server.orderIndex, count);
+    for (int i = 0; i < count; ++i) {
+        Order *newOrder = orders[i];
+        newOrder->orderId = firstId + i;
+        newOrder->status = ORDER_RECEIVED;
+        newOrder->customerX = locations[2 * i];
+        newOrder->customerY = locations[2 * i + 1];
+        newOrder->menuItem = menuItem;
+        newOrder->client = session->id;
+        stampOrder(newOrder, STAMP_RECEIVED);
+    }
+    // journalled before the index makes them cancellable, a cancel record always comes after
+    journalOrders(orders, count);
+    for (int i = 0; i < count; ++i) {
+        if (indexOrder(&server.orderIndex, orders[i]) == -1) {
+            while (i-- > 0) {
+                unindexOrder(&server.orderIndex, orders[i]->orderId);
+            }
+            for (int j = 0; j < count; ++j) {
+                journalStage(orders[j]->orderId, JOURNAL_CANCELLED);
+                releaseOrder(orders[j]);
+            }
+            finishSessionOrders(&server.sessions, session, count);
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        orderIds[i] = orders[i]->orderId; // a cook may take the order right after enqueue
+        logEvent(LOG_ORDER_CREATED, orders[i]->orderId, orders[i]->customerX, orders[i]->customerY, 0);
+    }
+
+    quoteOrders(orders, count);
+    atomic_fetch_add(&ordersReceived, count);
+    feedKitchen(&server.sessions, session, orders, count); // a session's orders start on one cook
+    return count;
+}
+
+// promises each order a delivery time: the wait for the cooks and couriers at the current
+// backlog, its own preparation and baking, the drive, and a slack. dueUs keeps the promise
+// less the drive, the time the meal has to leave the shop, so the kitchen and the dispatcher
+// serve whichever order has the least time left instead of whichever came first. a quote is
+// capped at MAX_QUOTE_MS, after that long no newer order has an earlier dueUs, so none is
+// passed over for longer than what arrived before that point takes
+void quoteOrders(Order **orders, int count) {
+    int cooks = poolSize(&server.cookPool), couriers = poolSize(&server.deliveryPool);
+    long cookWaitNs = __atomic_load_n(&prepMeanNs, __ATOMIC_RELAXED) / (cooks > 0 ? cooks : 1);
+    long ready = readyOrders(&server.dispatcher);
+    long courierWaitNs = ready * __atomic_load_n(&deliveryMeanNs, __ATOMIC_RELAXED) / (couriers > 0 ? couriers : 1);
+    long ahead = pendingWork(&server.kitchen) + backloggedOrders(&server.sessions);
+    for (int i = 0; i < count; ++i) {
+        Order *order = orders[i];
+        long prepNs = __atomic_load_n(&prepEstimateNs[order->menuItem], __ATOMIC_RELAXED);
+        long quoteNs = (ahead + i) * cookWaitNs + 2 * prepNs + courierWaitNs + promiseSlackNs; // the oven takes as long as the cook
+        if (quoteNs > MAX_QUOTE_MS * 1000000L) quoteNs = MAX_QUOTE_MS * 1000000L;
+        order->dueUs = order->stamps[STAMP_RECEIVED] + (uint32_t)(quoteNs / 1000);
+    }
+}
+
+// the promise is dueUs plus the drive straight from the shop, at the stamp of the handover
+int deliveredLate(const Order *order) {
+    uint32_t promisedUs = order->dueUs + (uint32_t)(hypot(order->customerX, order->customerY) / server.speed * 1e6);
+    return (int32_t)(order->stamps[STAMP_DELIVERED] - promisedUs) > 0;
+}
+
+// only one thread's update wins when two race, an estimate does not need every sample
+void updateEstimate(long *estimateNs, long ns) {
+    long estimate = __atomic_load_n(estimateNs, __ATOMIC_RELAXED);
+    __atomic_store_n(estimateNs, estimate == 0 ? ns : estimate + (ns - estimate) / ESTIMATE_SMOOTHING, __ATOMIC_RELAXED);
+}
+
+// after the index shard is unlocked, an append may wait for the journal writer
+void journalCancel(int orderId) {
+    journalStage(orderId, JOURNAL_CANCELLED);
+}
+
+// orders the last run acknowledged and did not finish come back under their old ids, in a
+// session of their own. the journal is then rewritten to just them so the next start does
+// not replay the whole history, and opened for this run before the cooks can touch them
+void recoverOrders(const char *path) {
+    RecoveredOrder *recovered;
+    int maxOrderId;
+    int count = replayJournal(path, &recovered, &maxOrderId);
+    if (count == -1) {
+        perror("Failed to read order journal");
+        exit(1);
+    }
+    if (rewriteJournal(path, recovered, count, maxOrderId) == -1 || openJournal(path) == -1) {
+        perror("Failed to open order journal");
+        exit(1);
+    }
+    atomic_store(&server.orderIndex.nextOrderId, maxOrderId + 1);
+    if (count == 0) {
+        free(recovered);
+        return;
+    }
+
+    Session *session = openSession(&server.sessions);
+    if (session == NULL || admitOrders(session, count, count) == -1) {
+        printf("No session for the recovered orders\n");
+        exit(1);
+    }
+    int baked = 0;
+    for (int done = 0; done < count; ) {
+        Order *orders[MAX_BATCH_ORDERS];
+        Order *kitchen[MAX_BATCH_ORDERS];
+        int batch = (count - done > MAX_BATCH_ORDERS) ? MAX_BATCH_ORDERS : count - done;
+        int cooking = 0;
+        if (allocOrders(orders, batch) == -1) {
+            perror("Failed to allocate recovered orders");
+            exit(1);
+        }
+        for (int i = 0; i < batch; ++i) {
+            RecoveredOrder *old = &recovered[done + i];
+            Order *order = orders[i];
+            order->orderId = old->orderId;
+            order->status = old->status;
+            order->customerX = old->customerX;
+            order->customerY = old->customerY;
+            order->menuItem = (old->menuItem < server.menuSize) ? old->menuItem : 0; // the menu may have shrunk
+            order->client = session->id;
+            stampOrder(order, STAMP_RECEIVED);
+            if (order->status == ORDER_COOKED) { // its kitchen stages count as zero
+                for (int stamp = STAMP_PREPARING; stamp <= STAMP_REMOVED; ++stamp) {
+                    order->stamps[stamp] = order->stamps[STAMP_RECEIVED];
+                }
+            }
+            if (indexOrder(&server.orderIndex, order) == -1) {
+                perror("Failed to index recovered orders");
+                exit(1);
+            }
+            logEvent(LOG_ORDER_CREATED, order->orderId, order->customerX, order->customerY, 0);
+        }
+        quoteOrders(orders, batch);
+        for (int i = 0; i < batch; ++i) {
+            if (orders[i]->status == ORDER_COOKED) {
+                addReadyOrder(&server.dispatcher, orders[i]);
+                baked++;
+            } else {
+                kitchen[cooking++] = orders[i];
+            }
+        }
+        if (cooking > 0) feedKitchen(&server.sessions, session, kitchen, cooking);
+        done += batch;
+    }
+    atomic_fetch_add(&ordersReceived, count);
+    closeSession(&server.sessions, session);
+    free(recovered);
+    printf("Recovered %d orders from %s, %d for the kitchen and %d for the couriers\n", count, path, count - baked, baked);
+    logLine("Recovered %d orders from %s, %d for the kitchen and %d for the couriers\n", count, path, count - baked, baked);
+}
+
+// the session new orders of this connection belong to. one shot messages share legacySession,
+// a framed connection has its own, and a finished session is followed by a fresh one
+Session *admitToSession(Connection *conn, int total, int count) {
+    int oneShot = conn->protocol == PROTOCOL_ONESHOT;
+    Session **current = oneShot ? &legacySession : &conn->session;
+    if (oneShot) pthread_mutex_lock(&legacyLock);
+    Session *session = *current;
+    while (session == NULL || admitOrders(session, total, count) == -1) {
+        if (session != NULL) releaseSession(&server.sessions, session);
+        session = *current = openSession(&server.sessions);
+        if (session == NULL) break; // MAX_SESSIONS clients at once
+        printf("%d new customer.. Serving session %d\n", total, session->id);
+        logLine("%d new customer.. Serving session %d\n", total, session->id);
+    }
+    if (oneShot) pthread_mutex_unlock(&legacyLock);
+    return session;
+}
+
+// handles one "x-y-total" or "cancelOrder" message, returns reply length (0 means no reply)
+int handleOrderMessage(char *message, Connection *conn, char *response, size_t responseSize) {
+    if (strcmp(message, "cancelOrder") == 0) { 
+        logLine("Received cancel order as a request..\n");
+        // cancels what is in the shop, the cooks and couriers keep running
+        int cancelled = cancelAllIndexedOrders(&server.orderIndex, journalCancel);
+        logLine("%d orders cancelled\n", cancelled);
+        return 0;
+    }
+
+    int customerX = 0, customerY = 0, total = 0;
+    sscanf(message, "%d-%d-%d", &customerX, &customerY, &total);
     
-    int clientSocket = (int)(intptr_t)arg;
-    char buffer[BUFFER_SIZE];
-    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-     
-    if (bytesReceived > 0) {
-        buffer[bytesReceived] = '\0'; 
-
-        if (strcmp(buffer, "cancelOrder") == 0) { 
-            snprintf(logText, sizeof(logText), "Received cancel order as a request..\n");
-            logMessage(logText);
-            pthread_mutex_lock(&cancelOrderMutex);
-            orderState = -3; 
-            pthread_mutex_unlock(&cancelOrderMutex);
-            return NULL;
-        }
-
-        Order *newOrder = (Order *)malloc(sizeof(Order));
-        newOrder->orderId = rand() % 100000; 
-        sscanf(buffer, "%d-%d-%d", &newOrder->customerX, &newOrder->customerY, &totalOrdersPlaced);
-        
-        if(newOrder->customerX == -999 && newOrder->customerY == -999){ // last element come, finished operations 
-            logMessage(logText);
-            char response[BUFFER_SIZE];
-            snprintf(response, sizeof(response), "All customers served!");
-            send(clientSocket, response, strlen(response), 0);
-            
-            //orderState = 1; 
-        }else{  
-            snprintf(logText, sizeof(logText), "Customer location: %d %d\n", newOrder->customerX, newOrder->customerY);
-            logMessage(logText);
-            strcpy(newOrder->status, "Received");
-
-            if(snprintf(logText, sizeof(logText), "Order %d created for location %s\n", newOrder->orderId, newOrder->customerLocation) < 0){
-                printf("buffer problem with snprintf in clientHandler\n");
+    if(customerX == -999 && customerY == -999){ // last element come, finished operations 
+        // the client sends no more, its session finishes with the orders it did send
+        pthread_mutex_lock(&legacyLock);
+        if (legacySession != NULL) closeSession(&server.sessions, legacySession);
+        legacySession = NULL;
+        pthread_mutex_unlock(&legacyLock);
+        snprintf(response, responseSize, "All customers served!");
+        return strlen(response);
+    }
+
+    int location[2] = { customerX, customerY };
+    int orderId;
+    Session *session = admitToSession(conn, total, 1);
+    if (session == NULL || createOrders(location, 1, 0, session, &orderId) == 0) {
+        snprintf(response, responseSize, "Order could not be placed!");
+        return strlen(response);
+    }
+    snprintf(response, responseSize, "Order %d has been placed successfully!", orderId);
+    return strlen(response);
+}
+
+// handles one framed request line, the reply echoes the client's sequence number
+//   "O <seq> <x> <y> <total> [item]"  ->  "R <seq> <orderId>"  ("D <seq>" for the -999 -999 end marker)
+//   "B <seq> <total> <count> <x1> <y1> ... <xn> <yn> [item]"  ->  "R <seq> <orderId1> ... <orderIdn>"
+//   "S <seq> <orderId>", "C <seq> <firstOrderId> [count]"  ->  see handleSupportMessage
+// item is a menu index, orders without one are the first item
+int handleFramedMessage(char *line, Connection *conn, char *reply, size_t replySize) {
+    char tag;
+    unsigned int seq;
+    int customerX, customerY, total, menuItem = 0;
+    if (sscanf(line, "%c %u", &tag, &seq) != 2) {
+        return snprintf(reply, replySize, "E 0 malformed request\n");
+    }
+    if (tag == 'S' || tag == 'C') { // support desk, does not start a session
+        return handleSupportMessage(tag, line, seq, reply, replySize);
+    }
+
+    switch (tag) {
+    case 'O':
+        if (sscanf(line + 1, "%u %d %d %d %d", &seq, &customerX, &customerY, &total, &menuItem) < 4) {
+            return snprintf(reply, replySize, "E %u malformed order\n", seq);
+        }
+        if (customerX == -999 && customerY == -999) { // does not start a session either
+            return snprintf(reply, replySize, "D %u\n", seq);
+        }
+        int location[2] = { customerX, customerY };
+        int orderId;
+        Session *session = admitToSession(conn, total, 1);
+        if (session == NULL || createOrders(location, 1, menuItem, session, &orderId) == 0) {
+            return snprintf(reply, replySize, "E %u order could not be placed\n", seq);
+        }
+        return snprintf(reply, replySize, "R %u %d\n", seq, orderId);
+    case 'B':
+        return handleBatchMessage(line, seq, conn, reply, replySize);
+    default:
+        return snprintf(reply, replySize, "E %u unknown request\n", seq);
+    }
+}
+
+// status query, or cancel of one order or of a whole batch (its ids are consecutive), answered
+// from the order index without touching the queues. recently finished orders are answered
+// from the index's finished slots, older ones are unknown
+//   "S <seq> <orderId>"  ->  "S <seq> <orderId> <status>"
+//   "C <seq> <firstOrderId> [count]"  ->  "C <seq> <cancelled> <alreadyOnTheWay> <unknown>"
+int handleSupportMessage(char tag, char *line, unsigned int seq, char *reply, size_t replySize) {
+    int orderId, count = 1;
+    if (sscanf(line + 1, "%u %d %d", &seq, &orderId, &count) < 2 || count <= 0 || count > MAX_BATCH_ORDERS) {
+        return snprintf(reply, replySize, "E %u malformed request\n", seq);
+    }
+    if (tag == 'S') {
+        int status = lookupOrderStatus(&server.orderIndex, orderId);
+        if (status == -1) return snprintf(reply, replySize, "E %u unknown order %d\n", seq, orderId);
+        return snprintf(reply, replySize, "S %u %d %s\n", seq, orderId, orderStatusName(status));
+    }
+
+    int cancelled = 0, onTheWay = 0, unknown = 0;
+    for (int i = 0; i < count; ++i) {
+        int status = cancelIndexedOrder(&server.orderIndex, orderId + i);
+        if (status == -1) unknown++;
+        else if (status <= ORDER_COOKED) {
+            journalCancel(orderId + i);
+            cancelled++;
+        } else if (status != ORDER_CANCELLED) onTheWay++;
+    }
+    logLine("Cancel request for orders %d..%d: %d cancelled, %d already on the way\n", orderId, orderId + count - 1, cancelled, onTheWay);
+    return snprintf(reply, replySize, "C %u %d %d %d\n", seq, cancelled, onTheWay, unknown);
+}
+
+// "B <seq> <total> <count> <x1> <y1> ... [item]", parsed in one pass with strtol
+int handleBatchMessage(char *line, unsigned int seq, Connection *conn, char *reply, size_t replySize) {
+    int locations[2 * MAX_BATCH_ORDERS];
+    int orderIds[MAX_BATCH_ORDERS];
+    char *cursor = line + 1, *end;
+
+    strtoul(cursor, &end, 10); // seq, already parsed
+    cursor = end;
+    long total = strtol(cursor, &end, 10);
+    if (end == cursor || total < 0 || total > INT_MAX) return snprintf(reply, replySize, "E %u malformed batch\n", seq);
+    cursor = end;
+    long count = strtol(cursor, &end, 10);
+    if (end == cursor || count <= 0 || count > MAX_BATCH_ORDERS) {
+        return snprintf(reply, replySize, "E %u batch must hold 1 to %d orders\n", seq, MAX_BATCH_ORDERS);
+    }
+    cursor = end;
+    int outOfRange = 0;
+    for (int i = 0; i < 2 * count; ++i) {
+        long coordinate = strtol(cursor, &end, 10);
+        if (end == cursor) return snprintf(reply, replySize, "E %u batch has fewer locations than %ld\n", seq, count);
+        // checked as a long, stored as an int it could wrap into range
+        if (coordinate < -MAX_CUSTOMER_DISTANCE || coordinate > MAX_CUSTOMER_DISTANCE) outOfRange = 1;
+        locations[i] = (int)coordinate;
+        cursor = end;
+    }
+    long menuItem = strtol(cursor, &end, 10);
+    if (end == cursor) menuItem = 0;
+    if (menuItem < 0 || menuItem > MAX_MENU_ITEMS) menuItem = -1; // refused by createOrders
+
+    Session *session = admitToSession(conn, total, count);
+    if (session != NULL && outOfRange) { // refused like any order createOrders turns down
+        finishSessionOrders(&server.sessions, session, count);
+        return snprintf(reply, replySize, "E %u location out of range\n", seq);
+    }
+    if (session == NULL || createOrders(locations, count, menuItem, session, orderIds) == 0) {
+        return snprintf(reply, replySize, "E %u batch could not be placed\n", seq);
+    }
+    int len = snprintf(reply, replySize, "R %u", seq);
+    for (int i = 0; i < count; ++i) {
+        len += snprintf(reply + len, replySize - len, " %d", orderIds[i]);
+    }
+    len += snprintf(reply + len, replySize - len, "\n");
+    return len;
+}
+
+// turns buffered input into replies in conn->out, returns -1 on a protocol error.
+// framed lines are only consumed while the reply buffer has room, the rest waits for the next flush.
+// replies that confirm journalled orders or cancels leave conn->ackMark for the sender to wait on
+int processInput(Connection *conn) {
+    uint64_t mark = journalMark();
+    conn->in[conn->inLen] = '\0';
+    if (conn->protocol == PROTOCOL_UNKNOWN && conn->inLen > 0) {
+        conn->protocol = (conn->in[0] >= 'A' && conn->in[0] <= 'Z') ? PROTOCOL_FRAMED : PROTOCOL_ONESHOT;
+    }
+
+    if (conn->protocol == PROTOCOL_ONESHOT) {
+        // one shot message, same as a single recv in the old clientHandler
+        conn->outLen = handleOrderMessage(conn->in, conn, conn->out, sizeof(conn->out));
+        conn->inLen = 0;
+        conn->closeAfterWrite = 1;
+        if (journalMark() != mark) conn->ackMark = journalMark();
+        return 0;
+    }
+
+    char *line = conn->in;
+    char *end = conn->in + conn->inLen;
+    while (conn->outLen + MAX_REPLY_LINE <= (int)sizeof(conn->out)) {
+        char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL) break;
+        if (*line == 'B' && conn->outLen + MAX_BATCH_REPLY > (int)sizeof(conn->out)) break; // wait for room for every id
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+        if (*line != '\0') {
+            conn->outLen += handleFramedMessage(line, conn, conn->out + conn->outLen, sizeof(conn->out) - conn->outLen);
+        }
+        line = newline + 1;
+    }
+    conn->inLen = end - line;
+    memmove(conn->in, line, conn->inLen);
+    if (conn->inLen == (int)sizeof(conn->in) - 1 && memchr(conn->in, '\n', conn->inLen) == NULL) return -1; // line longer than the buffer
+    if (journalMark() != mark) conn->ackMark = journalMark();
+    return 0;
+}
+
+void closeConnection(FrontEndWorker *worker, Connection *conn) {
+    if (conn->session != NULL) closeSession(&server.sessions, conn->session);
+    epoll_ctl(worker->epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn);
+}
+
+// writes pending replies, keeps going through buffered requests and then waits for
+// EPOLLOUT while replies are stuck or EPOLLIN once everything is answered
+void serviceConnection(FrontEndWorker *worker, Connection *conn) {
+    while (1) {
+        if (conn->ackMark != 0) { // no reply before the orders it confirms are on disk
+            waitJournal(conn->ackMark);
+            conn->ackMark = 0;
+        }
+        while (conn->outSent < conn->outLen) {
+            ssize_t sent = send(conn->fd, conn->out + conn->outSent, conn->outLen - conn->outSent, MSG_NOSIGNAL);
+            if (sent > 0) {
+                conn->outSent += sent;
+                continue;
             }
-            
-            logMessage(logText); 
- 
-            enqueue(&server.orderQueue, newOrder);
+            if (sent == -1 && errno == EINTR) continue;
+            if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                struct epoll_event event;
+                event.events = EPOLLOUT;
+                event.data.ptr = conn;
+                epoll_ctl(worker->epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+                return;
+            }
+            closeConnection(worker, conn);
+            return;
+        }
+        conn->outLen = conn->outSent = 0;
+        if (conn->closeAfterWrite) {
+            closeConnection(worker, conn);
+            return;
+        }
+        if (processInput(conn) == -1) {
+            closeConnection(worker, conn);
+            return;
+        }
+        if (conn->outLen == 0) break;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    epoll_ctl(worker->epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+}
 
-            char response[BUFFER_SIZE];
-            snprintf(response, sizeof(response), "Order %d has been placed successfully!", newOrder->orderId);
-            send(clientSocket, response, strlen(response), 0);
-        } 
+void acceptConnections(FrontEndWorker *worker) {
+    while (1) {
+        int clientSocket = accept4(worker->listenSocket, NULL, NULL, SOCK_NONBLOCK);
+        if (clientSocket == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logLine("Socket Accept failed\n");
+            }
+            return;
+        }
+        Connection *conn = (Connection *)malloc(sizeof(Connection));
+        memset(conn, 0, offsetof(Connection, in));
+        conn->fd = clientSocket;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        if (epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, clientSocket, &event) == -1) {
+            close(clientSocket);
+            free(conn);
+        }
     }
+}
 
-    close(clientSocket);
+// 1 when the connection has replies for serviceConnection, 0 when there is nothing or it was closed
+int readConnection(FrontEndWorker *worker, Connection *conn) {
+    ssize_t bytesReceived;
+    while ((bytesReceived = recv(conn->fd, conn->in + conn->inLen, sizeof(conn->in) - 1 - conn->inLen, 0)) == -1 && errno == EINTR);
+    if (bytesReceived == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    if (bytesReceived <= 0) {
+        closeConnection(worker, conn);
+        return 0;
+    }
+    conn->inLen += bytesReceived;
+    if (processInput(conn) == -1) {
+        closeConnection(worker, conn);
+        return 0;
+    }
+    return 1;
+}
+
+void *frontEndThread(void *arg) {
+    FrontEndWorker *worker = (FrontEndWorker *)arg;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    seedRandom(MAX_COOKS + worker->id);
+    while (1) {
+        int ready = epoll_wait(worker->epollFd, events, MAX_EPOLL_EVENTS, -1);
+        if (ready == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        // every connection of this pass is read before any is answered, so the first reply
+        // waits for one journal sync that covers the orders of all of them
+        Connection *answer[MAX_EPOLL_EVENTS];
+        int answers = 0;
+        for (int i = 0; i < ready; ++i) {
+            Connection *conn = (Connection *)events[i].data.ptr;
+            if (conn == NULL) {
+                acceptConnections(worker);
+            } else if (events[i].events & EPOLLOUT) {
+                answer[answers++] = conn;
+            } else if (readConnection(worker, conn)) { // also reports EPOLLHUP/EPOLLERR through recv
+                answer[answers++] = conn;
+            }
+        }
+        for (int i = 0; i < answers; ++i) {
+            serviceConnection(worker, answer[i]);
+        }
+    }
     return NULL;
 }
 
+// sleeps until the last order of a session is delivered or dropped and reports it once, with
+// its own counts and stage latencies. cancel points are shop wide, they come once no session
+// is open, with the stage latencies of the whole busy spell when it had more than one session
 void *managerHandler(void *arg){ 
+    int spellSessions = 0;
     while(1){ 
-        pthread_mutex_lock(&countLock); 
-        if(orderState == -3){  // canceled operation 
-            printf("canceling orders..\n");
-            orderState = -1;
-            totalOrdersPlaced = 0;
-            totalOrdersCompleted = 0;
-            pthread_mutex_unlock(&countLock);
-            startServer(&server);
+        Session *session = waitFinishedSession(&server.sessions);
+        printf("done serving session %d @ %d\n", session->id, getpid()); 
+        logLine("done serving session %d @ PID %d\n", session->id, getpid());
+        printBestDeliveryPerson(&server, session);
+        printSessionLatency(session);
+        releaseSession(&server.sessions, session);
+        spellSessions++;
+
+        if (openSessions(&server.sessions) == 0) {
+            logLine("All operations are done.\n");
+            printCancelReport();
+            if (spellSessions > 1) printLatencyReport(1);
+            else restartLatencyReport();
+            spellSessions = 0;
+            printf("active waiting for connections\n");
+        }
+    }
+}
+
+// called by the manager
+void printCancelReport() {
+    for (int i = 0; i < CANCEL_POINTS; ++i) {
+        int count = atomic_exchange(&cancelledAt[i], 0);
+        if (count == 0) continue;
+        logLine("Cancelled %s: %d orders\n", cancelPoints[i], count);
+    }
+}
+
+void *statsThread(void *arg) {
+    sigset_t statsSignal;
+    sigemptyset(&statsSignal);
+    sigaddset(&statsSignal, SIGUSR1);
+    sigaddset(&statsSignal, SIGINT);
+    sigaddset(&statsSignal, SIGTERM);
+    while (1) {
+        int signum;
+        if (sigwait(&statsSignal, &signum) != 0) continue;
+        if (signum == SIGUSR1) {
+            printLatencyReport(0);
             continue;
         }
-        else if(orderState == -2){
-            printf("%d new customer.. Serving ", totalOrdersPlaced);
-            orderState = 0;
+        logLine("Server shutting down...");
+        closeServer(&server);
+        exit(0);
+    }
+    return NULL;
+}
+
+// enough workers for what arrives plus the backlog spread over STAFFING_DRAIN_SECONDS, at the
+// rate one busy worker has kept up lately. growing follows the load at once, shrinking waits
+// for STAFFING_SHRINK_TICKS ticks in a row that need fewer, so a short lull keeps the staff
+int wantedWorkers(Staffing *staff, long arrivals, long done, long busyNs, size_t backlog, double seconds) {
+    double arrivalRate = (arrivals - staff->lastArrivals) / seconds;
+    staff->arrivalRate += STAFFING_SMOOTHING * (arrivalRate - staff->arrivalRate);
+    double busySeconds = (busyNs - staff->lastBusyNs) / 1e9;
+    if (done > staff->lastDone && busySeconds > 0.01) { // too little work in a tick says nothing about the rate
+        double serviceRate = (done - staff->lastDone) / busySeconds;
+        staff->serviceRate = (staff->serviceRate == 0) ? serviceRate : staff->serviceRate + STAFFING_SMOOTHING * (serviceRate - staff->serviceRate);
+        staff->lastDone = done;
+        staff->lastBusyNs = busyNs;
+    }
+    staff->lastArrivals = arrivals;
+
+    WorkerPool *pool = staff->pool;
+    int size = poolSize(pool);
+    int wanted;
+    if (staff->serviceRate == 0) {
+        wanted = (backlog > (size_t)size) ? size + 1 : size; // nothing measured yet, one more while work piles up
+    } else {
+        wanted = (int)ceil((staff->arrivalRate + backlog / STAFFING_DRAIN_SECONDS) / staff->serviceRate);
+    }
+    if (wanted < pool->minWorkers) wanted = pool->minWorkers;
+    if (wanted > pool->maxWorkers) wanted = pool->maxWorkers;
+
+    if (wanted >= size) {
+        staff->surplusTicks = 0;
+        return wanted;
+    }
+    if (++staff->surplusTicks < STAFFING_SHRINK_TICKS) return size;
+    staff->surplusTicks = 0;
+    return size - 1;
+}
+
+// resizes the elastic pools every STAFFING_TICK_MS, only started when a pool has a range
+void *staffingThread(void *arg) {
+    PideShopServer *shop = (PideShopServer *)arg;
+    Staffing *cooks = &shop->cookStaffing;
+    Staffing *couriers = &shop->deliveryStaffing;
+    memset(cooks, 0, sizeof(*cooks));
+    memset(couriers, 0, sizeof(*couriers));
+    cooks->pool = &shop->cookPool;
+    couriers->pool = &shop->deliveryPool;
+
+    long last = nowNs();
+    struct timespec tick = { 0, STAFFING_TICK_MS * 1000000L };
+    while (1) {
+        nanosleep(&tick, NULL);
+        long now = nowNs();
+        double seconds = (now - last) / 1e9;
+        last = now;
+
+        long cookBusyNs = 0, courierBusyNs = 0;
+        for (int i = 0; i < shop->cookPool.started; ++i) {
+            cookBusyNs += __atomic_load_n(&shop->cooks[i].busyNs, __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < shop->deliveryPool.started; ++i) {
+            courierBusyNs += __atomic_load_n(&shop->delivery[i].busyTotalNs, __ATOMIC_RELAXED);
         }
-        else if(orderState == 0){ // order runs  - // if order state equals 0 and totalOrdersCompleted is not changed, orderState = 2
-            if((totalOrdersCompleted % MAX_DELIVERY_BAG_CAPACITY) == 0){ 
-                if((totalOrdersPlaced - totalOrdersCompleted) < MAX_DELIVERY_BAG_CAPACITY) orderState = 2;                
-            }
-        }else if(orderState == 1){ // order finished 
-            printf("done serving client @ %d\n", getpid()); 
-            snprintf(logText, sizeof(logText), "done serving client @ PID %d\n", getpid());
-            logMessage(logText);
-
-            snprintf(logText, sizeof(logText), "All operations are done.\n");
-            logMessage(logText); 
-            printBestDeliveryPerson(&server); // Print best delivery person before shutdown
-            orderState = -1;
-            startServer(&server);
-            printf("active waiting for connections\n");
-        }else if(orderState == 2){ // stuck orders
-            //bitir isi
-            orderState = 1;
+
+        // the held back session orders wait for a cook as much as the queued ones. cooks
+        // waiting for an oven slot would not go faster with more of them
+        size_t cookBacklog = pendingWork(&shop->kitchen) + backloggedOrders(&shop->sessions);
+        int cookSize = poolSize(&shop->cookPool);
+        int wantedCooks = wantedWorkers(cooks, atomic_load(&ordersReceived), atomic_load(&ordersPrepared), cookBusyNs, cookBacklog, seconds);
+        if (wantedCooks > cookSize && cooksWaitingForOven(&shop->ovens) > 0) wantedCooks = cookSize;
+        if (wantedCooks != cookSize) {
+            resizeCooks(shop, wantedCooks);
+            logLine("Staffing: %d cooks, %zu orders waiting, %.1f orders/s in, %.1f orders/s per cook\n",
+                    poolSize(&shop->cookPool), cookBacklog, cooks->arrivalRate, cooks->serviceRate);
+        }
+
+        size_t courierBacklog = readyOrders(&shop->dispatcher);
+        int courierSize = poolSize(&shop->deliveryPool);
+        int wantedCouriers = wantedWorkers(couriers, atomic_load(&ordersBaked), atomic_load(&ordersDelivered), courierBusyNs, courierBacklog, seconds);
+        if (wantedCouriers != courierSize) {
+            resizeDelivery(shop, wantedCouriers);
+            logLine("Staffing: %d delivery persons, %zu meals waiting, %.1f meals/s in, %.1f deliveries/s per courier\n",
+                    poolSize(&shop->deliveryPool), courierBacklog, couriers->arrivalRate, couriers->serviceRate);
         }
-        pthread_mutex_unlock(&countLock); 
     }
+    return NULL;
 }
 
-void printBestDeliveryPerson(PideShopServer *server) {
+// only the owner adds to a busy counter, the atomic store lets a scrape read it whole
+void addBusyTime(long *busyNs, long ns) {
+    __atomic_store_n(busyNs, __atomic_load_n(busyNs, __ATOMIC_RELAXED) + ns, __ATOMIC_RELAXED);
+}
+
+// admin thread, once per ADMIN_TICK_MS
+void sampleMetrics(void *ctx) {
+    long now = nowNs();
+    sampleRate(&receivedRate, atomic_load(&ordersReceived), now);
+    sampleRate(&deliveredRate, atomic_load(&ordersDelivered), now);
+}
+
+// every value is an atomic or a relaxed read, a scrape takes no lock the shop uses
+void writeMetrics(MetricsText *out, void *ctx) {
+    PideShopServer *shop = (PideShopServer *)ctx;
+    char labels[32];
+    double uptime = (nowNs() - serverStartNs) / 1e9;
+
+    metricHeader(out, "pideshop_uptime_seconds", "gauge", "Seconds since the server started.");
+    metricValue(out, "pideshop_uptime_seconds", NULL, uptime);
+    metricHeader(out, "pideshop_orders_received_total", "counter", "Orders accepted from clients.");
+    metricValue(out, "pideshop_orders_received_total", NULL, atomic_load(&ordersReceived));
+    metricHeader(out, "pideshop_orders_delivered_total", "counter", "Orders handed to customers.");
+    metricValue(out, "pideshop_orders_delivered_total", NULL, atomic_load(&ordersDelivered));
+    metricHeader(out, "pideshop_orders_cancelled_total", "counter", "Orders dropped after a cancel.");
+    metricValue(out, "pideshop_orders_cancelled_total", NULL, atomic_load(&ordersCancelled));
+    metricHeader(out, "pideshop_orders_late_total", "counter", "Orders delivered after the promised time.");
+    metricValue(out, "pideshop_orders_late_total", NULL, atomic_load(&ordersLate));
+    metricHeader(out, "pideshop_journal_records_total", "counter", "Order journal records written and synced to disk.");
+    metricValue(out, "pideshop_journal_records_total", NULL, durableRecords());
+    metricHeader(out, "pideshop_journal_syncs_total", "counter", "fdatasync calls of the order journal, each one covers every record appended since the last.");
+    metricValue(out, "pideshop_journal_syncs_total", NULL, journalSyncs());
+    metricHeader(out, "pideshop_log_lost_bytes_total", "counter", "Event log bytes dropped because the log file would not take them or a thread got no ring.");
+    metricValue(out, "pideshop_log_lost_bytes_total", NULL, logLost());
+    metricHeader(out, "pideshop_orders_in_per_second", "gauge", "Orders received per second over the last 10 seconds.");
+    metricValue(out, "pideshop_orders_in_per_second", NULL, windowRate(&receivedRate));
+    metricHeader(out, "pideshop_orders_out_per_second", "gauge", "Orders delivered per second over the last 10 seconds.");
+    metricValue(out, "pideshop_orders_out_per_second", NULL, windowRate(&deliveredRate));
+    metricHeader(out, "pideshop_sessions_total", "counter", "Client sessions opened.");
+    metricValue(out, "pideshop_sessions_total", NULL, atomic_load(&shop->sessions.opened));
+    metricHeader(out, "pideshop_sessions_open", "gauge", "Client sessions with orders still to deliver.");
+    metricValue(out, "pideshop_sessions_open", NULL, openSessions(&shop->sessions));
+    metricHeader(out, "pideshop_cooks", "gauge", "Cooks in the pool, between the configured min and max.");
+    metricValue(out, "pideshop_cooks", NULL, poolSize(&shop->cookPool));
+    metricHeader(out, "pideshop_couriers", "gauge", "Delivery persons in the pool, between the configured min and max.");
+    metricValue(out, "pideshop_couriers", NULL, poolSize(&shop->deliveryPool));
+
+    metricHeader(out, "pideshop_kitchen_queue_length", "gauge", "Orders waiting for a cook.");
+    metricValue(out, "pideshop_kitchen_queue_length", NULL, pendingWork(&shop->kitchen));
+    metricHeader(out, "pideshop_delivery_queue_length", "gauge", "Baked orders waiting for a courier.");
+    metricValue(out, "pideshop_delivery_queue_length", NULL, readyOrders(&shop->dispatcher));
+    metricHeader(out, "pideshop_cooks_waiting_for_oven", "gauge", "Cooks holding a meal until an oven slot frees.");
+    metricValue(out, "pideshop_cooks_waiting_for_oven", NULL, cooksWaitingForOven(&shop->ovens));
+    metricHeader(out, "pideshop_oven_meals", "gauge", "Meals inside each oven.");
+    int meals = 0;
+    for (int i = 0; i < MAX_OVEN_APARATUS; ++i) {
+        int inside = mealsInOven(&shop->ovens, i);
+        snprintf(labels, sizeof(labels), "oven=\"%d\"", i);
+        metricValue(out, "pideshop_oven_meals", labels, inside);
+        meals += inside;
+    }
+    metricHeader(out, "pideshop_oven_utilization", "gauge", "Share of all oven slots in use.");
+    metricValue(out, "pideshop_oven_utilization", NULL, (double)meals / OVEN_SLOTS);
+
+    metricHeader(out, "pideshop_cook_busy_seconds_total", "counter", "Time a cook spent preparing or waiting for an oven slot.");
+    for (int i = 0; i < shop->cookPool.started; ++i) {
+        snprintf(labels, sizeof(labels), "cook=\"%d\"", i);
+        metricValue(out, "pideshop_cook_busy_seconds_total", labels, __atomic_load_n(&shop->cooks[i].busyNs, __ATOMIC_RELAXED) / 1e9);
+    }
+    metricHeader(out, "pideshop_cook_idle_seconds_total", "counter", "Uptime a cook was not busy.");
+    for (int i = 0; i < shop->cookPool.started; ++i) {
+        snprintf(labels, sizeof(labels), "cook=\"%d\"", i);
+        metricValue(out, "pideshop_cook_idle_seconds_total", labels, uptime - __atomic_load_n(&shop->cooks[i].busyNs, __ATOMIC_RELAXED) / 1e9);
+    }
+    metricHeader(out, "pideshop_courier_busy_seconds_total", "counter", "Time a courier spent on the road.");
+    for (int i = 0; i < shop->deliveryPool.started; ++i) {
+        snprintf(labels, sizeof(labels), "courier=\"%d\"", i);
+        metricValue(out, "pideshop_courier_busy_seconds_total", labels, __atomic_load_n(&shop->delivery[i].busyTotalNs, __ATOMIC_RELAXED) / 1e9);
+    }
+    metricHeader(out, "pideshop_courier_idle_seconds_total", "counter", "Uptime a courier spent at the shop.");
+    for (int i = 0; i < shop->deliveryPool.started; ++i) {
+        snprintf(labels, sizeof(labels), "courier=\"%d\"", i);
+        metricValue(out, "pideshop_courier_idle_seconds_total", labels, uptime - __atomic_load_n(&shop->delivery[i].busyTotalNs, __ATOMIC_RELAXED) / 1e9);
+    }
+}
+
+// reportLock held, p50/p90/p99/max per stage in milliseconds
+void printStageLatencies(const StageLatencies *latencies, const char *scope) {
+    uint64_t delivered = histogramCount(&latencies->stages[STAGE_TOTAL]);
+    printf("stage latency over %llu delivered orders%s (ms):\n", (unsigned long long)delivered, scope);
+    logLine("Stage latency over %llu delivered orders%s (ms)\n", (unsigned long long)delivered, scope);
+    for (int stage = 0; stage < ORDER_STAGES && delivered > 0; ++stage) {
+        const LatencyHistogram *histogram = &latencies->stages[stage];
+        char line[128];
+        snprintf(line, sizeof(line), "  %-10s p50 %9.3f  p90 %9.3f  p99 %9.3f  max %9.3f\n", stageName(stage),
+                 histogramPercentile(histogram, 50) / 1e3, histogramPercentile(histogram, 90) / 1e3,
+                 histogramPercentile(histogram, 99) / 1e3, histogramPercentile(histogram, 100) / 1e3);
+        printf("%s", line);
+        logLine("%s", line);
+    }
+    fflush(stdout);
+}
+
+// the orders delivered since the shop was last idle, over every session. the report at the
+// end of a busy spell starts the next one from the current counts
+void printLatencyReport(int endOfSpell) {
+    pthread_mutex_lock(&reportLock);
+    collectStageLatencies(&latencyReport);
+    StageLatencies *now = &latencyReport;
+    StageLatencies snapshot = *now;
+    subtractStageLatencies(now, &spellStart);
+    if (endOfSpell) spellStart = snapshot;
+    printStageLatencies(now, endOfSpell ? " of every session" : " so far");
+    pthread_mutex_unlock(&reportLock);
+}
+
+// a spell of one session was reported with the session, only the baseline moves
+void restartLatencyReport() {
+    pthread_mutex_lock(&reportLock);
+    collectStageLatencies(&spellStart);
+    pthread_mutex_unlock(&reportLock);
+}
+
+// called by the manager once the session's last order finished, every courier is done adding to it
+void printSessionLatency(Session *session) {
+    char scope[32];
+    snprintf(scope, sizeof(scope), " of session %d", session->id);
+    pthread_mutex_lock(&reportLock);
+    printStageLatencies(session->latencies, scope);
+    pthread_mutex_unlock(&reportLock);
+}
+
+// the session's own counts, the best courier is the one that delivered most of its orders
+void printBestDeliveryPerson(PideShopServer *server, Session *session) {
     int bestScore = -1;
     int bestDeliveryPersonId = -1;
     for (int i = 0; i < server->deliveryPoolSize; ++i) {
-        if (server->delivery[i].deliveryScore > bestScore) {
-            bestScore = server->delivery[i].deliveryScore;
+        int score = session->courierDeliveries[i] * 10; // 10 points for each successful delivery
+        if (score > 0 && score > bestScore) {
+            bestScore = score;
             bestDeliveryPersonId = server->delivery[i].id;
         }
     }
+    int delivered = atomic_load(&session->delivered);
+    int late = atomic_load(&session->late);
+    logLine("Session %d: %d orders, %d delivered, %d cancelled in %.2f s\n", session->id, session->received,
+            delivered, atomic_load(&session->cancelled), (session->endNs - session->startNs) / 1e9);
+    if (delivered > 0) {
+        printf("On time: %.1f%% of %d delivered, %d late\n", 100.0 * (delivered - late) / delivered, delivered, late);
+        logLine("On time: %.1f%% of %d delivered, %d late\n", 100.0 * (delivered - late) / delivered, delivered, late);
+    }
     if (bestDeliveryPersonId != -1) {
         printf("Thanks Cook %d and Moto%d \n",1, bestDeliveryPersonId);
-        snprintf(logText, sizeof(logText), "Best Delivery Person: %d with a score of %d\n", bestDeliveryPersonId, bestScore);
-        logMessage(logText); 
+        logLine("Best Delivery Person: %d with a score of %d\n", bestDeliveryPersonId, bestScore);
+        // staffing cost, courier time to this session's customers divided over its deliveries
+        logLine("Courier time per order: %.2f s over %d orders\n", atomic_load(&session->roadNs) / 1e9 / delivered, delivered);
     } else {
         printf("No deliveries were made.\n");
     }
 }
  
-void returnTimeOfMatrix() {
-    int ROWS = 30, COLS = 40;
-    
-    Complex A[ROWS][COLS];
+// preparation time is the Moore-Penrose pseudo-inverse of a random complex matrix sized by the menu item
+void returnTimeOfMatrix(Cook *cook, int menuItem) {
+    int ROWS = server.menu[menuItem].rows, COLS = server.menu[menuItem].cols;
+    ComplexMatrix *A = &cook->recipe;
     
+    if (resizeComplexMatrix(A, ROWS, COLS) == -1 || resizeComplexMatrix(&cook->recipeInverse, COLS, ROWS) == -1) {
+        printf("not enough memory for %s matrix\n", server.menu[menuItem].name);
+        return;
+    }
+
     // Initialize A with some complex values
     for (int i = 0; i < ROWS; ++i) {
-        for (int j = 0; j < COLS; ++j) {
-            A[i][j].real = rand() % 10;
-            A[i][j].imag = rand() % 10;
-        } 
+        fillRandomBelow(A->re + (size_t)i * A->stride, COLS, 10);
+        fillRandomBelow(A->im + (size_t)i * A->stride, COLS, 10);
     }
 
-    Complex B[COLS][ROWS];
- 
-    for (int i = 0; i < ROWS; ++i) {
-        for (int j = 0; j < COLS; ++j) {
-            B[j][i] = complex_conj(A[i][j]);
-        }
-    }  
-    
-}
\ No newline at end of file
+    pseudoInverse(A, &cook->recipeInverse, &cook->workspace);
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "session.h"
+
+long sessionClockNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void initSessionTable(SessionTable *table, WorkScheduler *kitchen, int cookCount, int courierCount) {
+    memset(table->used, 0, sizeof(table->used));
+    for (int i = 0; i < MAX_SESSIONS; ++i) {
+        table->sessions[i].id = i;
+        pthread_mutex_init(&table->sessions[i].lock, NULL);
+    }
+    table->nextSlot = 0;
+    table->open = 0;
+    atomic_init(&table->opened, 0);
+    table->courierCount = courierCount;
+    setKitchenShare(table, cookCount);
+    atomic_init(&table->backlogged, 0);
+    table->kitchen = kitchen;
+    pthread_mutex_init(&table->lock, NULL);
+    pthread_cond_init(&table->sessionFinished, NULL);
+    table->finishedHead = NULL;
+    table->finishedTail = NULL;
+}
+
+void setKitchenShare(SessionTable *table, int cookCount) {
+    __atomic_store_n(&table->kitchenShare, SESSION_KITCHEN_SHARE * (cookCount > 0 ? cookCount : 1), __ATOMIC_RELAXED);
+}
+
+Session *openSession(SessionTable *table) {
+    int *courierDeliveries = (int *)calloc(table->courierCount, sizeof(int));
+    StageLatencies *latencies = (StageLatencies *)calloc(1, sizeof(StageLatencies));
+    if (courierDeliveries == NULL || latencies == NULL) {
+        free(courierDeliveries);
+        free(latencies);
+        return NULL;
+    }
+    pthread_mutex_lock(&table->lock);
+    int slot = -1;
+    for (int i = 0; i < MAX_SESSIONS && slot == -1; ++i) {
+        int candidate = (table->nextSlot + i) % MAX_SESSIONS;
+        if (!table->used[candidate]) slot = candidate;
+    }
+    if (slot == -1) {
+        pthread_mutex_unlock(&table->lock);
+        free(courierDeliveries);
+        free(latencies);
+        return NULL;
+    }
+    table->used[slot] = 1;
+    table->nextSlot = (slot + 1) % MAX_SESSIONS; // a freed slot rests before it is reused
+    table->open++;
+    pthread_mutex_unlock(&table->lock);
+    atomic_fetch_add(&table->opened, 1);
+
+    Session *session = &table->sessions[slot];
+    session->placed = 0;
+    session->received = 0;
+    session->closed = 0;
+    session->finished = 0;
+    atomic_init(&session->inFlight, 0);
+    atomic_init(&session->delivered, 0);
+    atomic_init(&session->cancelled, 0);
+    atomic_init(&session->late, 0);
+    atomic_init(&session->refs, 2);
+    atomic_init(&session->roadNs, 0);
+    session->courierDeliveries = courierDeliveries;
+    session->latencies = latencies;
+    session->startNs = sessionClockNs();
+    session->endNs = 0;
+    session->backlogHead = NULL;
+    session->backlogTail = NULL;
+    session->backlog = 0;
+    session->inKitchen = 0;
+    session->nextFinished = NULL;
+    return session;
+}
+
+Session *sessionOf(SessionTable *table, int slot) {
+    return &table->sessions[slot];
+}
+
+int admitOrders(Session *session, int total, int count) {
+    pthread_mutex_lock(&session->lock);
+    if (session->finished) {
+        pthread_mutex_unlock(&session->lock);
+        return -1;
+    }
+    session->placed = total;
+    session->received += count;
+    atomic_fetch_add(&session->inFlight, count);
+    pthread_mutex_unlock(&session->lock);
+    return 0;
+}
+
+// session lock held. moves backlog orders into out while the session is under its share
+int refillKitchen(SessionTable *table, Session *session, Order **out, int capacity) {
+    int moved = 0, share = __atomic_load_n(&table->kitchenShare, __ATOMIC_RELAXED);
+    while (moved < capacity && session->backlog > 0 && session->inKitchen < share) {
+        Order *order = session->backlogHead;
+        session->backlogHead = order->next;
+        if (session->backlogHead == NULL) session->backlogTail = NULL;
+        order->next = NULL;
+        session->backlog--;
+        session->inKitchen++;
+        out[moved++] = order;
+    }
+    if (moved > 0) atomic_fetch_sub(&table->backlogged, moved);
+    return moved;
+}
+
+void feedKitchen(SessionTable *table, Session *session, Order **orders, int count) {
+    Order *ready[count];
+    pthread_mutex_lock(&session->lock);
+    for (int i = 0; i < count; ++i) {
+        orders[i]->next = NULL;
+        if (session->backlogTail != NULL) session->backlogTail->next = orders[i];
+        else session->backlogHead = orders[i];
+        session->backlogTail = orders[i];
+    }
+    session->backlog += count;
+    atomic_fetch_add(&table->backlogged, count);
+    int moved = refillKitchen(table, session, ready, count);
+    pthread_mutex_unlock(&session->lock);
+    // outside the session lock, a cook taking one of these waits on it in leftKitchen
+    if (moved > 0) submitWork(table->kitchen, session->id, ready, moved);
+}
+
+// usually one order replaces the one taken, more once a bigger cook pool raised the share
+void leftKitchen(SessionTable *table, Session *session) {
+    Order *next[SESSION_KITCHEN_SHARE * 4];
+    pthread_mutex_lock(&session->lock);
+    session->inKitchen--;
+    int moved = refillKitchen(table, session, next, SESSION_KITCHEN_SHARE * 4);
+    pthread_mutex_unlock(&session->lock);
+    if (moved > 0) submitWork(table->kitchen, session->id, next, moved);
+}
+
+// session lock held. the last order is done and the client cannot send more
+void tryFinishSession(SessionTable *table, Session *session) {
+    if (session->finished || atomic_load(&session->inFlight) > 0) return;
+    if (!session->closed && session->received < session->placed) return;
+    session->finished = 1;
+    session->endNs = sessionClockNs();
+    pthread_mutex_lock(&table->lock);
+    table->open--;
+    session->nextFinished = NULL;
+    if (table->finishedTail != NULL) table->finishedTail->nextFinished = session;
+    else table->finishedHead = session;
+    table->finishedTail = session;
+    pthread_cond_signal(&table->sessionFinished);
+    pthread_mutex_unlock(&table->lock);
+}
+
+// only the call that empties the session takes its lock, and it checks inFlight again
+// under it, so an admitOrders in between keeps the session open
+void finishSessionOrders(SessionTable *table, Session *session, int count) {
+    if (atomic_fetch_sub(&session->inFlight, count) != count) return;
+    pthread_mutex_lock(&session->lock);
+    tryFinishSession(table, session);
+    pthread_mutex_unlock(&session->lock);
+}
+
+void closeSession(SessionTable *table, Session *session) {
+    pthread_mutex_lock(&session->lock);
+    session->closed = 1;
+    tryFinishSession(table, session);
+    pthread_mutex_unlock(&session->lock);
+    releaseSession(table, session);
+}
+
+Session *waitFinishedSession(SessionTable *table) {
+    pthread_mutex_lock(&table->lock);
+    while (table->finishedHead == NULL) {
+        pthread_cond_wait(&table->sessionFinished, &table->lock);
+    }
+    Session *session = table->finishedHead;
+    table->finishedHead = session->nextFinished;
+    if (table->finishedHead == NULL) table->finishedTail = NULL;
+    pthread_mutex_unlock(&table->lock);
+    return session;
+}
+
+void releaseSession(SessionTable *table, Session *session) {
+    if (atomic_fetch_sub(&session->refs, 1) != 1) return;
+    free(session->courierDeliveries);
+    session->courierDeliveries = NULL;
+    free(session->latencies);
+    session->latencies = NULL;
+    pthread_mutex_lock(&table->lock);
+    table->used[session->id] = 0;
+    pthread_mutex_unlock(&table->lock);
+}
+
+int openSessions(SessionTable *table) {
+    return __atomic_load_n(&table->open, __ATOMIC_RELAXED);
+}
+
+int backloggedOrders(SessionTable *table) {
+    return atomic_load_explicit(&table->backlogged, memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "order.h"
+#include "workScheduler.h"
+#include "latencyHistogram.h"
+
+#define MAX_SESSIONS 1024 // open at once, an order carries its session slot in order->client
+#define SESSION_KITCHEN_SHARE 2 // orders per cook one session may have waiting for the cooks
+
+// one client run with its own counts. every session shares the cooks and couriers, but only
+// keeps kitchenShare orders in the kitchen and holds the rest in its backlog, so the kitchen
+// queue interleaves the open sessions instead of serving whoever sent the most first
+typedef struct Session {
+    int id;
+    int placed; // the client's declared total, under lock
+    int received; // admitted orders, refused ones included, under lock
+    int closed; // the connection is gone, no more orders come
+    int finished; // reported or about to be, a new order opens a new session
+    atomic_int inFlight; // admitted and not yet delivered, dropped or refused
+    atomic_int delivered;
+    atomic_int cancelled;
+    atomic_int late; // delivered after the time the customer was promised
+    atomic_int refs; // the connection and the unfinished orders each hold one
+    atomic_long roadNs; // courier time from the previous stop to this session's customers
+    int *courierDeliveries; // one per courier, only that courier writes it
+    StageLatencies *latencies; // stage times of the session's delivered orders, every courier adds to it
+    long startNs;
+    long endNs;
+    pthread_mutex_t lock;
+    Order *backlogHead; // linked through order->next
+    Order *backlogTail;
+    int backlog;
+    int inKitchen;
+    struct Session *nextFinished;
+} Session;
+
+typedef struct {
+    Session sessions[MAX_SESSIONS];
+    int used[MAX_SESSIONS]; // under lock
+    int nextSlot;
+    int open; // not finished yet
+    atomic_long opened;
+    int courierCount;
+    int kitchenShare; // changes with the cook pool, read without the table lock
+    atomic_int backlogged; // orders held back in every session's backlog
+    WorkScheduler *kitchen;
+    pthread_mutex_t lock;
+    pthread_cond_t sessionFinished;
+    Session *finishedHead;
+    Session *finishedTail;
+} SessionTable;
+
+void initSessionTable(SessionTable *table, WorkScheduler *kitchen, int cookCount, int courierCount);
+void setKitchenShare(SessionTable *table, int cookCount); // when the cook pool resizes
+Session *openSession(SessionTable *table); // NULL when MAX_SESSIONS are open, the caller holds one reference
+Session *sessionOf(SessionTable *table, int slot);
+int admitOrders(Session *session, int total, int count); // -1 once the session finished
+void feedKitchen(SessionTable *table, Session *session, Order **orders, int count); // admitted orders, in order
+void leftKitchen(SessionTable *table, Session *session); // a cook took one of the session's orders
+void finishSessionOrders(SessionTable *table, Session *session, int count); // delivered, dropped or refused
+void closeSession(SessionTable *table, Session *session); // the connection is gone, drops its reference
+Session *waitFinishedSession(SessionTable *table); // blocks, the caller then holds the orders' reference
+void releaseSession(SessionTable *table, Session *session);
+int openSessions(SessionTable *table); // without the lock, for reports and metrics
+int backloggedOrders(SessionTable *table);
+
+#endif
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "simulation.h"
+#include "dispatcher.h"
+#include "deadlineHeap.h"
+#include "oven.h"
+#include "fastRandom.h"
+
+#define EVENT_ARRIVAL 0
+#define EVENT_PREPARED 1 // a cook finished a meal and wants an oven slot
+#define EVENT_BAKED 2
+#define EVENT_RETURNED 3 // a courier is back at the shop
+// dueUs counts this many virtual ns in the simulator. dueBefore compares 32 bit differences,
+// in 100 us units those stay right for dues up to 59 hours apart, past the longest trace
+#define SIM_DUE_UNIT_NS 100000
+#define SIM_ESTIMATE_SMOOTHING 8 // the server's ESTIMATE_SMOOTHING, a measurement moves an estimate by 1/8
+
+typedef struct {
+    long timeNs;
+    long sequence; // scheduling order breaks ties, so a trace always replays the same way
+    int type;
+    int worker;
+    Order *order;
+} SimEvent;
+
+typedef struct {
+    const SimulationConfig *config;
+    long now;
+    long scheduled;
+    SimEvent *heap;
+    int heapSize;
+    int heapCapacity;
+    long events;
+
+    Order *orders;
+    const TraceOrder *trace;
+    long *deliveredNs;
+    long *promisedNs; // the quote plus the drive straight from the shop, per order
+    DeadlineHeap kitchen; // earliest due first, like the server's cook deques
+    long prepMeanNs; // what the server's quotes are made from, measured the same way
+    long deliveryMeanNs;
+    int *idleCooks;
+    int idleCookCount;
+    Order **cookMeal; // meal a cook holds while every oven slot is taken
+    long *waitStart;
+    int *ovenWaiters; // cooks in the order they started waiting
+    int ovenWaitHead;
+    int ovenWaitCount;
+    int freeSlots;
+    Dispatcher dispatcher;
+    int *idleCouriers;
+    int idleCourierCount;
+
+    long cookBusyNs;
+    long ovenWaitNs;
+    long courierBusyNs;
+    double distance;
+    int bags;
+    int delivered;
+    int late;
+} Simulation;
+
+void *simAlloc(size_t bytes) {
+    void *memory = calloc(1, bytes);
+    if (memory == NULL) {
+        perror("Failed to allocate simulation");
+        exit(1);
+    }
+    return memory;
+}
+
+int eventBefore(const SimEvent *a, const SimEvent *b) {
+    return a->timeNs < b->timeNs || (a->timeNs == b->timeNs && a->sequence < b->sequence);
+}
+
+void schedule(Simulation *sim, long timeNs, int type, int worker, Order *order) {
+    if (sim->heapSize == sim->heapCapacity) {
+        sim->heapCapacity *= 2;
+        sim->heap = (SimEvent *)realloc(sim->heap, sizeof(SimEvent) * sim->heapCapacity);
+        if (sim->heap == NULL) {
+            perror("Failed to grow event heap");
+            exit(1);
+        }
+    }
+    SimEvent event = { timeNs, sim->scheduled++, type, worker, order };
+    int at = sim->heapSize++;
+    while (at > 0 && eventBefore(&event, &sim->heap[(at - 1) / 2])) {
+        sim->heap[at] = sim->heap[(at - 1) / 2];
+        at = (at - 1) / 2;
+    }
+    sim->heap[at] = event;
+}
+
+SimEvent nextEvent(Simulation *sim) {
+    SimEvent first = sim->heap[0];
+    SimEvent last = sim->heap[--sim->heapSize];
+    int at = 0;
+    while (1) {
+        int child = 2 * at + 1;
+        if (child >= sim->heapSize) break;
+        if (child + 1 < sim->heapSize && eventBefore(&sim->heap[child + 1], &sim->heap[child])) child++;
+        if (!eventBefore(&sim->heap[child], &last)) break;
+        sim->heap[at] = sim->heap[child];
+        at = child;
+    }
+    sim->heap[at] = last;
+    return first;
+}
+
+long mealNs(Simulation *sim, const Order *order) {
+    return sim->config->prepNs[order->menuItem];
+}
+
+void smoothEstimate(long *estimateNs, long ns) {
+    *estimateNs = (*estimateNs == 0) ? ns : *estimateNs + (ns - *estimateNs) / SIM_ESTIMATE_SMOOTHING;
+}
+
+// quoteOrders in the server: the wait for the cooks and couriers at the current backlog, the
+// meal's own preparation and baking, and the slack. dueUs is when the meal has to leave
+void quoteOrder(Simulation *sim, Order *order, long arrivalNs) {
+    const SimulationConfig *config = sim->config;
+    long quoteNs = sim->kitchen.count * sim->prepMeanNs / config->cooks + 2 * mealNs(sim, order)
+                 + sim->dispatcher.waiting * sim->deliveryMeanNs / config->couriers + config->promiseSlackNs;
+    if (quoteNs > config->maxQuoteNs) quoteNs = config->maxQuoteNs;
+    order->dueUs = (uint32_t)((arrivalNs + quoteNs) / SIM_DUE_UNIT_NS);
+    long driveNs = (long)(hypot(order->customerX, order->customerY) / config->speed * 1e9);
+    sim->promisedNs[order->orderId - 1] = arrivalNs + quoteNs + driveNs;
+}
+
+// idle cooks take the order with the earliest due, the server's steals keep it as work conserving
+void startCooking(Simulation *sim) {
+    while (sim->idleCookCount > 0 && sim->kitchen.count > 0) {
+        Order *order = popEarliest(&sim->kitchen);
+        int cook = sim->idleCooks[--sim->idleCookCount];
+        order->status = ORDER_PREPARING;
+        sim->cookBusyNs += mealNs(sim, order);
+        smoothEstimate(&sim->prepMeanNs, mealNs(sim, order));
+        schedule(sim, sim->now + mealNs(sim, order), EVENT_PREPARED, cook, order);
+    }
+}
+
+// bake time is the preparation time, like bakeInOven in the server
+void bake(Simulation *sim, Order *order) {
+    sim->freeSlots--;
+    order->status = ORDER_COOKING;
+    schedule(sim, sim->now + mealNs(sim, order), EVENT_BAKED, 0, order);
+}
+
+// a courier at the shop leaves with the oldest meal and its nearest neighbours and is
+// back after the planned tour, every stop is delivered on the way
+void dispatchCouriers(Simulation *sim) {
+    Order *bag[MAX_BAG_STOPS];
+    while (sim->idleCourierCount > 0 && sim->dispatcher.waiting > 0) {
+        int courier = sim->idleCouriers[--sim->idleCourierCount];
+        int count = tryTakeBag(&sim->dispatcher, bag, sim->config->bagCapacity);
+        double route = planRoute(bag, count);
+        double travelled = 0.0;
+        int x = 0, y = 0;
+        for (int i = 0; i < count; ++i) {
+            travelled += stopDistance(x, y, bag[i]);
+            x = bag[i]->customerX;
+            y = bag[i]->customerY;
+            bag[i]->status = ORDER_DELIVERED;
+            sim->deliveredNs[bag[i]->orderId - 1] = sim->now + (long)(travelled / sim->config->speed * 1e9);
+            if (sim->deliveredNs[bag[i]->orderId - 1] > sim->promisedNs[bag[i]->orderId - 1]) sim->late++;
+        }
+        long tripNs = (long)(route / sim->config->speed * 1e9);
+        smoothEstimate(&sim->deliveryMeanNs, tripNs / count);
+        sim->courierBusyNs += tripNs;
+        sim->distance += route;
+        sim->bags++;
+        sim->delivered += count;
+        schedule(sim, sim->now + tripNs, EVENT_RETURNED, courier, NULL);
+    }
+}
+
+void handleEvent(Simulation *sim, const SimEvent *event) {
+    switch (event->type) {
+    case EVENT_ARRIVAL:
+        quoteOrder(sim, event->order, sim->now);
+        if (pushDeadline(&sim->kitchen, event->order) == -1) {
+            perror("Failed to grow simulated kitchen");
+            exit(1);
+        }
+        break;
+    case EVENT_PREPARED:
+        if (sim->freeSlots > 0) {
+            bake(sim, event->order);
+            sim->idleCooks[sim->idleCookCount++] = event->worker;
+        } else {
+            int cooks = sim->config->cooks;
+            sim->cookMeal[event->worker] = event->order;
+            sim->waitStart[event->worker] = sim->now;
+            sim->ovenWaiters[(sim->ovenWaitHead + sim->ovenWaitCount++) % cooks] = event->worker;
+        }
+        break;
+    case EVENT_BAKED:
+        sim->freeSlots++;
+        if (sim->ovenWaitCount > 0) {
+            int cook = sim->ovenWaiters[sim->ovenWaitHead];
+            sim->ovenWaitHead = (sim->ovenWaitHead + 1) % sim->config->cooks;
+            sim->ovenWaitCount--;
+            sim->ovenWaitNs += sim->now - sim->waitStart[cook];
+            sim->cookBusyNs += sim->now - sim->waitStart[cook];
+            bake(sim, sim->cookMeal[cook]);
+            sim->idleCooks[sim->idleCookCount++] = cook;
+        }
+        event->order->status = ORDER_COOKED;
+        addReadyOrder(&sim->dispatcher, event->order);
+        break;
+    case EVENT_RETURNED:
+        sim->idleCouriers[sim->idleCourierCount++] = event->worker;
+        break;
+    }
+    startCooking(sim);
+    dispatchCouriers(sim);
+}
+
+int compareLong(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+void formatClock(long ns, char *text, size_t size) {
+    long seconds = ns / 1000000000L;
+    snprintf(text, size, "%02ld:%02ld:%02ld", seconds / 3600, seconds / 60 % 60, seconds % 60);
+}
+
+void printSimulationReport(Simulation *sim, int count, double wallSeconds) {
+    const SimulationConfig *config = sim->config;
+    long *latency = (long *)simAlloc(sizeof(long) * (count > 0 ? count : 1));
+    double latencySum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        latency[i] = sim->deliveredNs[i] - sim->trace[i].arrivalNs;
+        latencySum += latency[i];
+    }
+    qsort(latency, count, sizeof(long), compareLong);
+    double makespan = sim->now > 0 ? (double)sim->now : 1.0;
+    char closing[32]; // hours of a long clock run past two digits
+    formatClock(sim->now, closing, sizeof(closing));
+
+    printf("simulated %d orders with %d cooks, %d couriers, speed %d, %d oven slots\n", count, config->cooks, config->couriers, config->speed, OVEN_SLOTS);
+    printf("last delivery at %s virtual, %.2f s wall, %ld events (%.0f/s)\n", closing, wallSeconds, sim->events, sim->events / (wallSeconds > 0 ? wallSeconds : 1e-9));
+    if (count == 0) {
+        free(latency);
+        return;
+    }
+    printf("order to door  mean %.1f s  p50 %.1f s  p90 %.1f s  p99 %.1f s  max %.1f s\n", latencySum / count / 1e9,
+           latency[count / 2] / 1e9, latency[(int)(count * 0.9)] / 1e9, latency[(int)(count * 0.99)] / 1e9, latency[count - 1] / 1e9);
+    printf("cooks busy %.1f%%, oven wait %.3f s per order\n", 100.0 * sim->cookBusyNs / (makespan * config->cooks), sim->ovenWaitNs / 1e9 / count);
+    printf("couriers busy %.1f%%, %.2f orders per bag, %.2f distance per order\n", 100.0 * sim->courierBusyNs / (makespan * config->couriers),
+           (double)sim->delivered / sim->bags, sim->distance / count);
+    printf("on time %.1f%% of %d delivered, %d late, promise slack %.1f s\n", 100.0 * (count - sim->late) / count, count, sim->late,
+           config->promiseSlackNs / 1e9);
+    free(latency);
+}
+
+void runSimulation(const SimulationConfig *config, const TraceOrder *trace, int count) {
+    Simulation sim = { 0 };
+    sim.config = config;
+    sim.trace = trace;
+    sim.heapCapacity = 64;
+    sim.heap = (SimEvent *)simAlloc(sizeof(SimEvent) * sim.heapCapacity);
+    sim.orders = (Order *)simAlloc(sizeof(Order) * (count > 0 ? count : 1));
+    sim.deliveredNs = (long *)simAlloc(sizeof(long) * (count > 0 ? count : 1));
+    sim.promisedNs = (long *)simAlloc(sizeof(long) * (count > 0 ? count : 1));
+    initDeadlineHeap(&sim.kitchen);
+    sim.idleCooks = (int *)simAlloc(sizeof(int) * config->cooks);
+    sim.cookMeal = (Order **)simAlloc(sizeof(Order *) * config->cooks);
+    sim.waitStart = (long *)simAlloc(sizeof(long) * config->cooks);
+    sim.ovenWaiters = (int *)simAlloc(sizeof(int) * config->cooks);
+    sim.idleCouriers = (int *)simAlloc(sizeof(int) * config->couriers);
+    sim.freeSlots = OVEN_SLOTS;
+    initDispatcher(&sim.dispatcher);
+    for (int i = config->cooks - 1; i >= 0; --i) {
+        sim.idleCooks[sim.idleCookCount++] = i;
+    }
+    for (int i = config->couriers - 1; i >= 0; --i) {
+        sim.idleCouriers[sim.idleCourierCount++] = i;
+    }
+    for (int i = 0; i < count; ++i) {
+        sim.orders[i].orderId = i + 1;
+        sim.orders[i].customerX = trace[i].customerX;
+        sim.orders[i].customerY = trace[i].customerY;
+        sim.orders[i].menuItem = trace[i].menuItem;
+        sim.orders[i].status = ORDER_RECEIVED;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int arrived = 0;
+    // arrivals join the heap one at a time, it only ever holds what is in the shop
+    if (count > 0) schedule(&sim, trace[0].arrivalNs, EVENT_ARRIVAL, 0, &sim.orders[arrived++]);
+    while (sim.heapSize > 0) {
+        SimEvent event = nextEvent(&sim);
+        sim.now = event.timeNs;
+        sim.events++;
+        if (event.type == EVENT_ARRIVAL && arrived < count) {
+            schedule(&sim, trace[arrived].arrivalNs, EVENT_ARRIVAL, 0, &sim.orders[arrived]);
+            arrived++;
+        }
+        handleEvent(&sim, &event);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printSimulationReport(&sim, count, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    destroyDispatcher(&sim.dispatcher);
+    free(sim.heap);
+    free(sim.orders);
+    free(sim.deliveredNs);
+    free(sim.promisedNs);
+    freeDeadlineHeap(&sim.kitchen);
+    free(sim.idleCooks);
+    free(sim.cookMeal);
+    free(sim.waitStart);
+    free(sim.ovenWaiters);
+    free(sim.idleCouriers);
+}
+
+int loadTrace(const char *path, int menuSize, TraceOrder **trace) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+    int count = 0, capacity = 1024;
+    TraceOrder *orders = (TraceOrder *)simAlloc(sizeof(TraceOrder) * capacity);
+    char line[BUFFER_SIZE];
+    long previous = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        double seconds;
+        TraceOrder order = { 0, 0, 0, 0 };
+        int fields = sscanf(line, "%lf %d %d %d", &seconds, &order.customerX, &order.customerY, &order.menuItem);
+        if (line[0] == '#' || fields < 3) continue;
+        order.arrivalNs = (long)(seconds * 1e9);
+        if (order.arrivalNs < previous || order.menuItem < 0 || order.menuItem >= menuSize
+            || order.customerX < -MAX_CUSTOMER_DISTANCE || order.customerX > MAX_CUSTOMER_DISTANCE
+            || order.customerY < -MAX_CUSTOMER_DISTANCE || order.customerY > MAX_CUSTOMER_DISTANCE) {
+            printf("trace line %d is out of time order, names an unknown menu item or a customer out of range\n", count + 1);
+            exit(1);
+        }
+        previous = order.arrivalNs;
+        if (count == capacity) {
+            capacity *= 2;
+            orders = (TraceOrder *)realloc(orders, sizeof(TraceOrder) * capacity);
+            if (orders == NULL) {
+                perror("Failed to grow trace");
+                exit(1);
+            }
+        }
+        orders[count++] = order;
+    }
+    fclose(file);
+    *trace = orders;
+    return count;
+}
+
+int syntheticTrace(int count, TraceOrder **trace) {
+    TraceOrder *orders = (TraceOrder *)simAlloc(sizeof(TraceOrder) * (count > 0 ? count : 1));
+    double meanGapNs = (double)SIM_DAY_SECONDS * 1e9 / count, now = 0.0;
+    for (int i = 0; i < count; ++i) {
+        double uniform = ((nextRandom() >> 11) + 1) * 0x1.0p-53; // (0, 1], keeps log finite
+        now += -log(uniform) * meanGapNs;
+        orders[i].arrivalNs = (long)now;
+        orders[i].customerX = randomBelow(2 * SIM_SPREAD + 1) - SIM_SPREAD;
+        orders[i].customerY = randomBelow(2 * SIM_SPREAD + 1) - SIM_SPREAD;
+        orders[i].menuItem = 0;
+    }
+    *trace = orders;
+    return count;
+}
@@ -0,0 +1,36 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "order.h"
+
+#define MAX_SIM_MENU_ITEMS 32
+#define SIM_DAY_SECONDS (12 * 3600) // synthetic traces spread their orders over one opening day
+#define SIM_SPREAD 15 // synthetic customers on [-15,15]^2, what runClient uses
+
+// one customer order of a trace, arrivalNs counts from opening time
+typedef struct {
+    long arrivalNs;
+    int customerX;
+    int customerY;
+    int menuItem;
+} TraceOrder;
+
+// the shop as server.c runs it, with the real cook work replaced by a cost model
+typedef struct {
+    int cooks;
+    int couriers;
+    int speed; // distance units per second
+    int bagCapacity;
+    int menuSize;
+    long prepNs[MAX_SIM_MENU_ITEMS]; // per menu item, the oven bakes as long again
+    long promiseSlackNs; // the server's quote parameters, PIDESHOP_PROMISE_SLACK_MS and MAX_QUOTE_MS
+    long maxQuoteNs;
+} SimulationConfig;
+
+// "<arrivalSeconds> <x> <y> [menuItem]" per line, # starts a comment. lines must be in time order
+int loadTrace(const char *path, int menuSize, TraceOrder **trace); // -1 when the file cannot be read
+int syntheticTrace(int count, TraceOrder **trace); // Poisson arrivals over SIM_DAY_SECONDS from the current seed
+// replays the trace in virtual time and prints the report, no thread sleeps or computes
+void runSimulation(const SimulationConfig *config, const TraceOrder *trace, int count);
+
+#endif
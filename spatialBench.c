@@ -0,0 +1,137 @@
+// spatialBench.c
+// spatial index against a linear scan for 1e3 .. 1e6 pending orders spread over
+// [-1000,1000]^2: insert and remove cost, nearest 4 from a courier position and all
+// orders within a radius. every query answer is checked against the scan
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "spatialIndex.h"
+#include "fastRandom.h"
+
+#define SPREAD 1000
+#define NEAREST_K 4
+#define QUERY_RADIUS 25.0
+#define MAX_WITHIN 4096
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// k smallest distances by a full pass, what a dispatcher without an index does
+int scanNearest(Order *orders, int count, int x, int y, int k, double *distance) {
+    int found = 0;
+    for (int i = 0; i < count; ++i) {
+        double d = hypot(orders[i].customerX - x, orders[i].customerY - y);
+        if (found == k && d >= distance[found - 1]) continue;
+        int at = (found < k) ? found++ : found - 1;
+        while (at > 0 && distance[at - 1] > d) {
+            distance[at] = distance[at - 1];
+            at--;
+        }
+        distance[at] = d;
+    }
+    return found;
+}
+
+int scanWithin(Order *orders, int count, int x, int y, double radius) {
+    int found = 0;
+    for (int i = 0; i < count; ++i) {
+        if (hypot(orders[i].customerX - x, orders[i].customerY - y) <= radius) found++;
+    }
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = { 1000, 10000, 100000, 1000000 };
+    int queries = (argc == 2) ? atoi(argv[1]) : 2000;
+    if (queries <= 0 || argc > 2) {
+        printf("Wrong Argument, please enter proper arguments: [queries(optional)]\n");
+        exit(1);
+    }
+    setRandomSeed(1);
+
+    printf("%d queries per size, k = %d, radius = %.0f, times per operation\n", queries, NEAREST_K, QUERY_RADIUS);
+    printf("%-9s %6s %9s %9s %10s %10s %10s %10s %7s\n", "orders", "side", "insert", "remove", "knn", "knn scan", "radius", "rad scan", "check");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int count = sizes[s];
+        int side = (int)ceil(sqrt(count / 4.0)); // about four orders per cell
+        int cellSize = (2 * SPREAD + side) / side;
+        Order *orders = calloc(count, sizeof(Order));
+        for (int i = 0; i < count; ++i) {
+            orders[i].orderId = i + 1;
+            orders[i].customerX = randomBelow(2 * SPREAD + 1) - SPREAD;
+            orders[i].customerY = randomBelow(2 * SPREAD + 1) - SPREAD;
+        }
+        SpatialIndex index;
+        initSpatialIndex(&index, cellSize, side);
+
+        double start = nowSeconds();
+        for (int i = 0; i < count; ++i) {
+            insertSpatial(&index, &orders[i]);
+        }
+        double insertNs = (nowSeconds() - start) * 1e9 / count;
+
+        // the scan is O(n) per query, fewer of them keep the large sizes bearable
+        int scans = queries * 1000 / count;
+        if (scans < 10) scans = 10;
+        if (scans > queries) scans = queries;
+        int *qx = malloc(sizeof(int) * queries), *qy = malloc(sizeof(int) * queries);
+        for (int i = 0; i < queries; ++i) {
+            qx[i] = randomBelow(2 * SPREAD + 1) - SPREAD;
+            qy[i] = randomBelow(2 * SPREAD + 1) - SPREAD;
+        }
+        Order *near[NEAREST_K];
+        Order **within = malloc(sizeof(Order *) * MAX_WITHIN);
+        start = nowSeconds();
+        for (int i = 0; i < queries; ++i) {
+            nearestOrders(&index, qx[i], qy[i], NEAREST_K, near);
+        }
+        double knnUs = (nowSeconds() - start) * 1e6 / queries;
+        start = nowSeconds();
+        for (int i = 0; i < queries; ++i) {
+            ordersWithin(&index, qx[i], qy[i], QUERY_RADIUS, within, MAX_WITHIN);
+        }
+        double radiusUs = (nowSeconds() - start) * 1e6 / queries;
+
+        double distance[NEAREST_K];
+        start = nowSeconds();
+        for (int i = 0; i < scans; ++i) {
+            scanNearest(orders, count, qx[i], qy[i], NEAREST_K, distance);
+        }
+        double knnScanUs = (nowSeconds() - start) * 1e6 / scans;
+        start = nowSeconds();
+        for (int i = 0; i < scans; ++i) {
+            scanWithin(orders, count, qx[i], qy[i], QUERY_RADIUS);
+        }
+        double radiusScanUs = (nowSeconds() - start) * 1e6 / scans;
+
+        int mismatches = 0;
+        for (int i = 0; i < scans; ++i) {
+            int found = nearestOrders(&index, qx[i], qy[i], NEAREST_K, near);
+            int expected = scanNearest(orders, count, qx[i], qy[i], NEAREST_K, distance);
+            if (found != expected) mismatches++;
+            for (int j = 0; j < found && j < expected; ++j) {
+                if (fabs(hypot(near[j]->customerX - qx[i], near[j]->customerY - qy[i]) - distance[j]) > 1e-9) mismatches++;
+            }
+            if (ordersWithin(&index, qx[i], qy[i], QUERY_RADIUS, within, MAX_WITHIN) != scanWithin(orders, count, qx[i], qy[i], QUERY_RADIUS)) mismatches++;
+        }
+
+        start = nowSeconds();
+        for (int i = 0; i < count; ++i) {
+            removeSpatial(&index, &orders[i]);
+        }
+        double removeNs = (nowSeconds() - start) * 1e9 / count;
+
+        printf("%-9d %6d %7.0fns %7.0fns %8.2fus %8.1fus %8.2fus %8.1fus %7s\n", count, side, insertNs, removeNs,
+               knnUs, knnScanUs, radiusUs, radiusScanUs, (mismatches == 0 && index.count == 0) ? "ok" : "FAIL");
+        freeSpatialIndex(&index);
+        free(within);
+        free(qx);
+        free(qy);
+        free(orders);
+    }
+    return 0;
+}
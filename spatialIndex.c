@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "spatialIndex.h"
+
+void initSpatialIndex(SpatialIndex *index, int cellSize, int side) {
+    pthread_rwlock_init(&index->lock, NULL);
+    index->cells = (SpatialCell *)calloc((size_t)side * side, sizeof(SpatialCell));
+    if (index->cells == NULL) {
+        perror("Failed to allocate spatial index");
+        exit(1);
+    }
+    index->cellSize = cellSize;
+    index->side = side;
+    index->count = 0;
+}
+
+void freeSpatialIndex(SpatialIndex *index) {
+    for (int i = 0; i < index->side * index->side; ++i) {
+        free(index->cells[i].items);
+    }
+    free(index->cells);
+    pthread_rwlock_destroy(&index->lock);
+}
+
+int cellCoordinate(SpatialIndex *index, int value) {
+    int cell = (int)floor((double)value / index->cellSize) + index->side / 2;
+    if (cell < 0) return 0;
+    if (cell >= index->side) return index->side - 1;
+    return cell;
+}
+
+SpatialCell *cellOf(SpatialIndex *index, const Order *order) {
+    return &index->cells[cellCoordinate(index, order->customerY) * index->side + cellCoordinate(index, order->customerX)];
+}
+
+int insertSpatial(SpatialIndex *index, Order *order) {
+    SpatialCell *cell = cellOf(index, order);
+    pthread_rwlock_wrlock(&index->lock);
+    if (cell->count == cell->capacity) {
+        int capacity = cell->capacity ? cell->capacity * 2 : 4;
+        Order **items = (Order **)realloc(cell->items, sizeof(Order *) * capacity);
+        if (items == NULL) {
+            pthread_rwlock_unlock(&index->lock);
+            return -1;
+        }
+        cell->items = items;
+        cell->capacity = capacity;
+    }
+    order->spatialSlot = cell->count;
+    cell->items[cell->count++] = order;
+    index->count++;
+    pthread_rwlock_unlock(&index->lock);
+    return 0;
+}
+
+// the last order of the cell fills the gap, write lock held
+void unlinkSpatial(SpatialIndex *index, Order *order) {
+    SpatialCell *cell = cellOf(index, order);
+    Order *last = cell->items[--cell->count];
+    cell->items[order->spatialSlot] = last;
+    last->spatialSlot = order->spatialSlot;
+    index->count--;
+}
+
+void removeSpatial(SpatialIndex *index, Order *order) {
+    pthread_rwlock_wrlock(&index->lock);
+    unlinkSpatial(index, order);
+    pthread_rwlock_unlock(&index->lock);
+}
+
+// ring search around the query cell. clamping to the grid never brings two points closer,
+// so every order in ring r is at least (r - 1) * cellSize away and the search can stop
+// once the k-th best is nearer than that
+int searchNearest(SpatialIndex *index, int x, int y, int k, Order **out) {
+    double distance[MAX_NEAREST_ORDERS];
+    int found = 0;
+    if (k > MAX_NEAREST_ORDERS) k = MAX_NEAREST_ORDERS;
+    if (k <= 0 || index->count == 0) return 0;
+    int centerX = cellCoordinate(index, x), centerY = cellCoordinate(index, y);
+    for (int ring = 0; ring < index->side; ++ring) {
+        if (found == k && (double)(ring - 1) * index->cellSize > distance[found - 1]) break;
+        if (centerX - ring < 0 && centerY - ring < 0 && centerX + ring >= index->side && centerY + ring >= index->side) break; // left the grid
+        for (int cy = centerY - ring; cy <= centerY + ring; ++cy) {
+            if (cy < 0 || cy >= index->side) continue;
+            int edgeRow = (cy == centerY - ring || cy == centerY + ring);
+            for (int cx = centerX - ring; cx <= centerX + ring; cx += edgeRow ? 1 : 2 * ring) { // inner rings are done
+                if (cx >= 0 && cx < index->side) {
+                    SpatialCell *cell = &index->cells[cy * index->side + cx];
+                    for (int i = 0; i < cell->count; ++i) {
+                        Order *order = cell->items[i];
+                        double d = hypot(order->customerX - x, order->customerY - y);
+                        if (found == k && d >= distance[found - 1]) continue;
+                        int at = (found < k) ? found++ : found - 1;
+                        while (at > 0 && distance[at - 1] > d) {
+                            out[at] = out[at - 1];
+                            distance[at] = distance[at - 1];
+                            at--;
+                        }
+                        out[at] = order;
+                        distance[at] = d;
+                    }
+                }
+                if (ring == 0) break;
+            }
+        }
+    }
+    return found;
+}
+
+int nearestOrders(SpatialIndex *index, int x, int y, int k, Order **out) {
+    pthread_rwlock_rdlock(&index->lock);
+    int found = searchNearest(index, x, y, k, out);
+    pthread_rwlock_unlock(&index->lock);
+    return found;
+}
+
+int takeNearestOrders(SpatialIndex *index, int x, int y, int k, Order **out) {
+    pthread_rwlock_wrlock(&index->lock);
+    int found = searchNearest(index, x, y, k, out);
+    for (int i = 0; i < found; ++i) {
+        unlinkSpatial(index, out[i]);
+    }
+    pthread_rwlock_unlock(&index->lock);
+    return found;
+}
+
+int ordersWithin(SpatialIndex *index, int x, int y, double radius, Order **out, int max) {
+    int reach = (int)ceil(radius);
+    int found = 0;
+    pthread_rwlock_rdlock(&index->lock);
+    int fromX = cellCoordinate(index, x - reach), toX = cellCoordinate(index, x + reach);
+    int fromY = cellCoordinate(index, y - reach), toY = cellCoordinate(index, y + reach);
+    for (int cy = fromY; cy <= toY && found < max; ++cy) {
+        for (int cx = fromX; cx <= toX && found < max; ++cx) {
+            SpatialCell *cell = &index->cells[cy * index->side + cx];
+            for (int i = 0; i < cell->count && found < max; ++i) {
+                Order *order = cell->items[i];
+                if (hypot(order->customerX - x, order->customerY - y) <= radius) out[found++] = order;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&index->lock);
+    return found;
+}
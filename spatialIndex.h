@@ -0,0 +1,37 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <pthread.h>
+#include "order.h"
+
+#define MAX_NEAREST_ORDERS 64
+
+typedef struct {
+    Order **items; // unordered, each order remembers its position in spatialSlot
+    int count;
+    int capacity;
+} SpatialCell;
+
+// uniform grid over customer locations, side x side cells of cellSize units centred on the
+// shop. locations past the edge go to the border cells, which only makes those cells
+// fuller, queries still measure real distances. queries share a read lock, so couriers
+// can search in parallel while inserts and removals take it exclusively
+typedef struct {
+    pthread_rwlock_t lock;
+    SpatialCell *cells;
+    int cellSize;
+    int side;
+    int count;
+} SpatialIndex;
+
+void initSpatialIndex(SpatialIndex *index, int cellSize, int side);
+void freeSpatialIndex(SpatialIndex *index);
+int insertSpatial(SpatialIndex *index, Order *order); // -1 when out of memory
+void removeSpatial(SpatialIndex *index, Order *order);
+// the k orders closest to (x, y), nearest first. the pointers are only a snapshot, an order
+// can be taken right after the lock is released, takeNearestOrders claims them instead
+int nearestOrders(SpatialIndex *index, int x, int y, int k, Order **out);
+int ordersWithin(SpatialIndex *index, int x, int y, double radius, Order **out, int max);
+int takeNearestOrders(SpatialIndex *index, int x, int y, int k, Order **out); // nearestOrders and remove them
+
+#endif
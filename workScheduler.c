@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "workScheduler.h"
+
+void initScheduler(WorkScheduler *scheduler, int workerCount) {
+    scheduler->deques = (WorkDeque *)aligned_alloc(WORK_ALIGN, sizeof(WorkDeque) * workerCount);
+    if (scheduler->deques == NULL) {
+        perror("Failed to allocate work deques");
+        exit(1);
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        WorkDeque *deque = &scheduler->deques[i];
+        pthread_mutex_init(&deque->lock, NULL);
+        initDeadlineHeap(&deque->heap);
+        atomic_init(&deque->size, 0);
+    }
+    scheduler->workerCount = workerCount;
+    atomic_init(&scheduler->activeWorkers, workerCount);
+    atomic_init(&scheduler->idleWorkers, 0);
+    pthread_mutex_init(&scheduler->parkLock, NULL);
+    pthread_cond_init(&scheduler->workReady, NULL);
+}
+
+void destroyScheduler(WorkScheduler *scheduler) {
+    for (int i = 0; i < scheduler->workerCount; ++i) {
+        pthread_mutex_destroy(&scheduler->deques[i].lock);
+        freeDeadlineHeap(&scheduler->deques[i].heap);
+    }
+    free(scheduler->deques);
+    pthread_mutex_destroy(&scheduler->parkLock);
+    pthread_cond_destroy(&scheduler->workReady);
+}
+
+size_t dequeSize(WorkDeque *deque) {
+    return atomic_load_explicit(&deque->size, memory_order_relaxed);
+}
+
+// deque lock held
+void pushOrders(WorkDeque *deque, Order **orders, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (pushDeadline(&deque->heap, orders[i]) == -1) {
+            perror("Failed to grow work deque");
+            exit(1);
+        }
+    }
+    atomic_store_explicit(&deque->size, deque->heap.count, memory_order_relaxed);
+}
+
+// the fence pairs with the one a parking worker issues after counting itself idle,
+// either it sees the new orders or we see it and wake it
+void wakeIdleWorkers(WorkScheduler *scheduler, int count) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&scheduler->idleWorkers, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&scheduler->parkLock);
+    if (count == 1) pthread_cond_signal(&scheduler->workReady);
+    else pthread_cond_broadcast(&scheduler->workReady);
+    pthread_mutex_unlock(&scheduler->parkLock);
+}
+
+void submitWork(WorkScheduler *scheduler, int affinity, Order **orders, int count) {
+    int active = atomic_load_explicit(&scheduler->activeWorkers, memory_order_relaxed);
+    WorkDeque *deque = &scheduler->deques[(unsigned int)affinity % (active > 0 ? active : scheduler->workerCount)];
+    pthread_mutex_lock(&deque->lock);
+    pushOrders(deque, orders, count);
+    pthread_mutex_unlock(&deque->lock);
+    wakeIdleWorkers(scheduler, count);
+}
+
+Order *popOwn(WorkDeque *deque) {
+    if (dequeSize(deque) == 0) return NULL;
+    pthread_mutex_lock(&deque->lock);
+    Order *order = popEarliest(&deque->heap);
+    atomic_store_explicit(&deque->size, deque->heap.count, memory_order_relaxed);
+    pthread_mutex_unlock(&deque->lock);
+    return order;
+}
+
+// moves up to half of a victim's later deadlines to the thief's deque and returns the earliest
+// of them. victims are visited from the thief's right neighbour on, so thieves spread over the pool
+Order *stealWork(WorkScheduler *scheduler, int worker) {
+    Order *stolen[WORK_STEAL_MAX];
+    for (int i = 1; i < scheduler->workerCount; ++i) {
+        WorkDeque *victim = &scheduler->deques[(worker + i) % scheduler->workerCount];
+        if (dequeSize(victim) == 0) continue;
+        pthread_mutex_lock(&victim->lock);
+        int take = (victim->heap.count + 1) / 2;
+        if (take > WORK_STEAL_MAX) take = WORK_STEAL_MAX;
+        for (int j = 0; j < take; ++j) {
+            stolen[j] = popLatest(&victim->heap);
+            if (dueBefore(stolen[j], stolen[0])) { // the earliest goes first, the thief runs it now
+                Order *earliest = stolen[j];
+                stolen[j] = stolen[0];
+                stolen[0] = earliest;
+            }
+        }
+        atomic_store_explicit(&victim->size, victim->heap.count, memory_order_relaxed);
+        pthread_mutex_unlock(&victim->lock);
+        if (take == 0) continue;
+
+        if (take > 1) {
+            WorkDeque *own = &scheduler->deques[worker];
+            pthread_mutex_lock(&own->lock);
+            pushOrders(own, stolen + 1, take - 1);
+            pthread_mutex_unlock(&own->lock);
+        }
+        return stolen[0];
+    }
+    return NULL;
+}
+
+Order *tryTakeWork(WorkScheduler *scheduler, int worker) {
+    Order *order = popOwn(&scheduler->deques[worker]);
+    return order != NULL ? order : stealWork(scheduler, worker);
+}
+
+void setActiveWorkers(WorkScheduler *scheduler, int activeWorkers) {
+    atomic_store(&scheduler->activeWorkers, activeWorkers);
+    pthread_mutex_lock(&scheduler->parkLock);
+    pthread_cond_broadcast(&scheduler->workReady);
+    pthread_mutex_unlock(&scheduler->parkLock);
+}
+
+// a worker past the active count hands what is left in its deque to an active one
+void handOffDeque(WorkScheduler *scheduler, int worker, int active) {
+    Order *left[WORK_STEAL_MAX];
+    WorkDeque *own = &scheduler->deques[worker];
+    while (active > 0 && dequeSize(own) > 0) {
+        int count = 0;
+        Order *order;
+        while (count < WORK_STEAL_MAX && (order = popOwn(own)) != NULL) {
+            left[count++] = order;
+        }
+        if (count > 0) submitWork(scheduler, worker % active, left, count);
+    }
+}
+
+Order *takeWork(WorkScheduler *scheduler, int worker) {
+    while (1) {
+        int active = atomic_load_explicit(&scheduler->activeWorkers, memory_order_relaxed);
+        if (worker >= active) {
+            handOffDeque(scheduler, worker, active);
+            return NULL;
+        }
+        Order *order = tryTakeWork(scheduler, worker);
+        if (order != NULL) return order;
+
+        pthread_mutex_lock(&scheduler->parkLock);
+        atomic_fetch_add(&scheduler->idleWorkers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (pendingWork(scheduler) == 0 && worker < atomic_load(&scheduler->activeWorkers)) pthread_cond_wait(&scheduler->workReady, &scheduler->parkLock);
+        atomic_fetch_sub(&scheduler->idleWorkers, 1);
+        pthread_mutex_unlock(&scheduler->parkLock);
+    }
+}
+
+size_t pendingWork(WorkScheduler *scheduler) {
+    size_t pending = 0;
+    for (int i = 0; i < scheduler->workerCount; ++i) {
+        pending += dequeSize(&scheduler->deques[i]);
+    }
+    return pending;
+}
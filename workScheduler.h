@@ -0,0 +1,42 @@
+#ifndef WORK_SCHEDULER_H
+#define WORK_SCHEDULER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include "order.h"
+#include "deadlineHeap.h"
+
+#define WORK_STEAL_MAX 32 // most orders moved by one steal
+#define WORK_ALIGN 64
+
+// one worker's orders, earliest deadline first. the owner takes the earliest from the top,
+// thieves take up to half from the end of the heap, leaves that mostly hold the later
+// deadlines. size is an atomic so a thief can skip empty deques without taking their lock
+typedef struct {
+    _Alignas(WORK_ALIGN) pthread_mutex_t lock;
+    DeadlineHeap heap;
+    atomic_size_t size;
+} WorkDeque;
+
+// work stealing pool of per worker deadline heaps. orders from one client go to the same
+// worker, idle workers steal before they sleep. deques exist for workerCount workers, new orders
+// only go to the first activeWorkers of them, the rest are emptied by stealing
+typedef struct {
+    WorkDeque *deques;
+    int workerCount;
+    atomic_int activeWorkers;
+    _Alignas(WORK_ALIGN) atomic_int idleWorkers;
+    pthread_mutex_t parkLock;
+    pthread_cond_t workReady;
+} WorkScheduler;
+
+void initScheduler(WorkScheduler *scheduler, int workerCount); // every worker starts active
+void destroyScheduler(WorkScheduler *scheduler); // workers must have stopped
+void submitWork(WorkScheduler *scheduler, int affinity, Order **orders, int count);
+void setActiveWorkers(WorkScheduler *scheduler, int activeWorkers); // wakes parked workers past the new count
+Order *takeWork(WorkScheduler *scheduler, int worker); // blocks until an order is available, NULL once worker >= activeWorkers
+Order *tryTakeWork(WorkScheduler *scheduler, int worker); // NULL when every deque is empty
+size_t pendingWork(WorkScheduler *scheduler); // approximate while workers run
+
+#endif
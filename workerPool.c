@@ -0,0 +1,110 @@
+#define _GNU_SOURCE // pthread_timedjoin_np
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "workerPool.h"
+
+void initWorkerPool(WorkerPool *pool, int minWorkers, int maxWorkers, WorkerMain run, void **args) {
+    pool->minWorkers = minWorkers;
+    pool->maxWorkers = maxWorkers;
+    atomic_init(&pool->size, 0);
+    pool->started = 0;
+    pool->retire = (atomic_int *)calloc(maxWorkers, sizeof(atomic_int));
+    pool->running = (int *)calloc(maxWorkers, sizeof(int));
+    pool->joinable = (int *)calloc(maxWorkers, sizeof(int));
+    pool->threads = (pthread_t *)calloc(maxWorkers, sizeof(pthread_t));
+    if (pool->retire == NULL || pool->running == NULL || pool->joinable == NULL || pool->threads == NULL) {
+        perror("Failed to allocate worker pool");
+        exit(1);
+    }
+    pool->args = args;
+    pool->run = run;
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+int growPool(WorkerPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    int id = atomic_load(&pool->size);
+    if (id < pool->maxWorkers) {
+        atomic_store(&pool->retire[id], 0);
+        if (!pool->running[id]) {
+            // an old thread of this id already left, it only has its return to finish
+            if (pool->joinable[id]) pthread_join(pool->threads[id], NULL);
+            pool->joinable[id] = 0;
+            if (pthread_create(&pool->threads[id], NULL, pool->run, pool->args[id]) != 0) {
+                pthread_mutex_unlock(&pool->lock);
+                return id;
+            }
+            pool->running[id] = 1;
+            pool->joinable[id] = 1;
+            if (id + 1 > pool->started) pool->started = id + 1;
+        }
+        atomic_store(&pool->size, id + 1);
+    }
+    int size = atomic_load(&pool->size);
+    pthread_mutex_unlock(&pool->lock);
+    return size;
+}
+
+int shrinkPool(WorkerPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    int size = atomic_load(&pool->size);
+    if (size > pool->minWorkers) {
+        atomic_store(&pool->retire[size - 1], 1);
+        atomic_store(&pool->size, --size);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return size;
+}
+
+int poolSize(WorkerPool *pool) {
+    return atomic_load_explicit(&pool->size, memory_order_relaxed);
+}
+
+int leavePool(WorkerPool *pool, int id) {
+    pthread_mutex_lock(&pool->lock);
+    int leave = atomic_load(&pool->retire[id]);
+    if (leave) pool->running[id] = 0;
+    pthread_mutex_unlock(&pool->lock);
+    return leave;
+}
+
+// wake gets parked workers to check their flag, a busy one sees it after its current order
+int stopPool(WorkerPool *pool, void (*wake)(void *ctx), void *ctx, int waitMs) {
+    pthread_mutex_lock(&pool->lock);
+    pool->minWorkers = 0;
+    for (int id = 0; id < pool->maxWorkers; ++id) {
+        atomic_store(&pool->retire[id], 1);
+    }
+    atomic_store(&pool->size, 0);
+    pthread_mutex_unlock(&pool->lock);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += waitMs / 1000;
+    deadline.tv_nsec += (waitMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    wake(ctx);
+    int leftRunning = 0;
+    for (int id = 0; id < pool->started; ++id) {
+        if (!pool->joinable[id]) continue;
+        if (waitMs == 0) pthread_join(pool->threads[id], NULL);
+        else if (pthread_timedjoin_np(pool->threads[id], NULL, &deadline) != 0) { // left running, exit takes it
+            leftRunning++;
+            continue;
+        }
+        pool->joinable[id] = 0;
+    }
+    return leftRunning;
+}
+
+void destroyWorkerPool(WorkerPool *pool) {
+    free(pool->retire);
+    free(pool->running);
+    free(pool->joinable);
+    free(pool->threads);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,34 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef void *(*WorkerMain)(void *arg);
+
+// threads with ids [0, size) between minWorkers and maxWorkers. shrinking asks the highest
+// id to retire, it leaves at its next wait for work, so no thread is cancelled in the middle
+// of an order. growing revives a retiring thread that has not left yet or starts a new one
+typedef struct {
+    int minWorkers;
+    int maxWorkers;
+    atomic_int size;
+    int started; // highest id ever started plus one
+    atomic_int *retire; // one per id, what the worker's wait for work checks
+    int *running; // under lock, the thread has not left yet
+    int *joinable;
+    pthread_t *threads;
+    void **args; // args[id] goes to the thread of that id
+    WorkerMain run;
+    pthread_mutex_t lock;
+} WorkerPool;
+
+void initWorkerPool(WorkerPool *pool, int minWorkers, int maxWorkers, WorkerMain run, void **args);
+int growPool(WorkerPool *pool); // new size, the same one at maxWorkers
+int shrinkPool(WorkerPool *pool); // new size, the same one at minWorkers
+int poolSize(WorkerPool *pool);
+int leavePool(WorkerPool *pool, int id); // 1 when the worker must return, 0 when it was revived meanwhile
+int stopPool(WorkerPool *pool, void (*wake)(void *ctx), void *ctx, int waitMs); // retires everyone, 0 waits forever. returns the workers still running
+void destroyWorkerPool(WorkerPool *pool);
+
+#endif